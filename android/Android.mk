@@ -62,11 +62,13 @@ LOCAL_SRC_FILES := app_main.c \
 	../src/support/cdi.c \
 	../src/annotation.cpp \
 	../src/aura.cpp \
+	../src/autosave.cpp \
 	../src/camp.cpp \
 	../src/cheat.cpp \
 	../src/city.cpp \
 	../src/codex.cpp \
 	../src/combat.cpp \
+	../src/combatsim.cpp \
 	../src/controller.cpp \
 	../src/context.cpp \
 	../src/creature.cpp \
@@ -96,18 +98,22 @@ LOCAL_SRC_FILES := app_main.c \
 	../src/movement.cpp \
 	../src/names.cpp \
 	../src/object.cpp \
+	../src/parallel.cpp \
 	../src/party.cpp \
 	../src/person.cpp \
 	../src/portal.cpp \
 	../src/progress_bar.cpp \
 	../src/rle.cpp \
 	../src/savegame.cpp \
+	../src/savewriter.cpp \
 	../src/scale.cpp \
 	../src/screen.cpp \
 	../src/settings.cpp \
 	../src/shrine.cpp \
+	../src/snapshot.cpp \
 	../src/spell.cpp \
 	../src/stats.cpp \
+	../src/telemetry.cpp \
 	../src/textview.cpp \
 	../src/tileanim.cpp \
 	../src/tile.cpp \
@@ -3,6 +3,7 @@ options [
 	use_faun: true
 	sdk_dir: none		"Path to Boron/Faun headers and libraries (UNIX only)"
 	gpu_render: false
+	use_egl: false		"Support --headless rendering with EGL (glv only)"
 	make_util: true
 ]
 
@@ -60,6 +61,10 @@ exe %xu4 [
 			unix [
 				include_from %src/glv/x11
 				libs [%Xcursor %X11]
+				if use_egl [
+					cflags "-DUSE_EGL"
+					libs %EGL
+				]
 				sources/flags [%src/glv/x11/glv.c] "-DUSE_CURSORS"
 			]
 			libs [%faun]
@@ -105,7 +110,7 @@ exe %xu4 [
 
 	unix [
 		cflags "-Wno-unused-parameter"
-		libs [%png %z]
+		libs [%png %z %pthread]
 	]
 	win32 [
 		either msvc [
@@ -125,11 +130,13 @@ exe %xu4 [
 	sources_from %src [
 		%annotation.cpp
 		%aura.cpp
+		%autosave.cpp
 		%camp.cpp
 		%cheat.cpp
 		%city.cpp
 		%codex.cpp
 		%combat.cpp
+		%combatsim.cpp
 		%controller.cpp
 		%context.cpp
 		%creature.cpp
@@ -158,18 +165,22 @@ exe %xu4 [
 		%menuitem.cpp
 		%names.cpp
 		%object.cpp
+		%parallel.cpp
 		%party.cpp
 		%person.cpp
 		%portal.cpp
 		%progress_bar.cpp
 		%rle.cpp
 		%savegame.cpp
+		%savewriter.cpp
 		%scale.cpp
 		%screen.cpp
 		%settings.cpp
 		%shrine.cpp
+		%snapshot.cpp
 		%spell.cpp
 		%stats.cpp
+		%telemetry.cpp
 		%textview.cpp
 		%tileanim.cpp
 		%tile.cpp
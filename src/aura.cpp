@@ -5,7 +5,7 @@
 #include "aura.h"
 #include "xu4.h"
 
-#define NOTIFY  gs_emitMessage(SENDER_AURA, this)
+#define NOTIFY  gs_postMessage(SENDER_AURA)
 
 Aura::Aura() : type(NONE), duration(0) {}
 
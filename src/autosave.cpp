@@ -0,0 +1,319 @@
+/*
+ * autosave.cpp
+ *
+ * Periodic autosaves kept in a ring of slot files (autosave<N>.sav).
+ *
+ * A slot holds an image of the normal save files (party.sav, monsters.sav,
+ * dngmap.sav & outmonst.sav) compressed with zlib.  The newest slot is a
+ * full image while each older slot is stored as the XOR delta against the
+ * next newer one, so successive saves which differ only slightly take very
+ * little space.  Restoring walks back from the newest image.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#include "autosave.h"
+#include "context.h"
+#include "game.h"
+#include "savegame.h"
+#include "savewriter.h"
+#include "settings.h"
+#include "xu4.h"
+
+#define AUTOSAVE_MAX_SLOTS  16
+#define IMAGE_FILES         4
+#define IMAGE_HEADER        (IMAGE_FILES * 4)
+
+struct AutosaveHeader {
+    char     magic[4];
+    uint32_t seq;           // Increases by one for each autosave.
+    uint32_t rawSize;       // Uncompressed image size.
+    uint32_t delta;         // Non-zero if XOR delta with next newer image.
+};
+
+static const char autosaveMagic[4] = {'X','A','S','1'};
+
+static const char* imageFiles[IMAGE_FILES] = {
+    PARTY_SAV, MONSTERS_SAV, DNGMAP_SAV, OUTMONST_SAV
+};
+
+static struct {
+    std::vector<uint8_t> prevImage;     // Image of slot seq.
+    uint32_t seq;                       // Zero if there is no previous slot.
+    uint32_t lastMoves;
+    bool scanned;
+    bool mapChanged;
+} as;
+
+static std::string slotPath(const char* userPath, int slot) {
+    char name[24];
+    snprintf(name, sizeof(name), "autosave%d.sav", slot);
+    return std::string(userPath) + name;
+}
+
+/*
+ * Read a slot header and optionally the uncompressed image.
+ * Return false if the slot does not exist or is damaged.
+ */
+static bool readSlot(const std::string& path, AutosaveHeader* hdr,
+                     std::vector<uint8_t>* raw) {
+    std::vector<uint8_t> packed;
+    FILE* fp;
+    long size;
+    bool ok = false;
+
+    fp = fopen(path.c_str(), "rb");
+    if (! fp)
+        return false;
+    if (fread(hdr, sizeof(AutosaveHeader), 1, fp) != 1 ||
+        memcmp(hdr->magic, autosaveMagic, 4) != 0)
+        goto done;
+
+    if (raw) {
+        fseek(fp, 0, SEEK_END);
+        size = ftell(fp) - (long) sizeof(AutosaveHeader);
+        fseek(fp, sizeof(AutosaveHeader), SEEK_SET);
+        if (size <= 0)
+            goto done;
+
+        packed.resize(size);
+        if (fread(packed.data(), 1, size, fp) != (size_t) size)
+            goto done;
+
+        uLongf rawLen = hdr->rawSize;
+        raw->resize(rawLen);
+        if (uncompress(raw->data(), &rawLen, packed.data(), size) != Z_OK ||
+            rawLen != hdr->rawSize)
+            goto done;
+    }
+    ok = true;
+
+done:
+    fclose(fp);
+    return ok;
+}
+
+/*
+ * Compress an image into an autosave slot file of job.
+ *
+ * Return false if compression failed and no file was added.
+ */
+static bool addSlot(SaveJob* job, int slot, uint32_t seq,
+                    const uint8_t* raw, size_t rawSize, bool delta) {
+    std::vector<uint8_t> packed(compressBound(rawSize));
+    uLongf packedLen = packed.size();
+    AutosaveHeader hdr;
+    char name[24];
+    uint8_t* dst;
+
+    if (compress2(packed.data(), &packedLen, raw, rawSize,
+                  Z_BEST_SPEED) != Z_OK)
+        return false;
+
+    memcpy(hdr.magic, autosaveMagic, 4);
+    hdr.seq = seq;
+    hdr.rawSize = rawSize;
+    hdr.delta = delta;
+
+    snprintf(name, sizeof(name), "autosave%d.sav", slot);
+    dst = savewriter_addFile(job, name, sizeof(hdr) + packedLen);
+    memcpy(dst, &hdr, sizeof(hdr));
+    memcpy(dst + sizeof(hdr), packed.data(), packedLen);
+    return true;
+}
+
+/*
+ * Concatenate the save files into an image which begins with the size of
+ * each file.
+ */
+static void buildImage(const SaveJob* files, std::vector<uint8_t>& img) {
+    const uint8_t* data[IMAGE_FILES];
+    uint32_t sizes[IMAGE_FILES];
+    size_t size, total = IMAGE_HEADER;
+    uint8_t* dst;
+    int i;
+
+    for (i = 0; i < IMAGE_FILES; ++i) {
+        data[i] = savewriter_fileData(files, i, &size);
+        sizes[i] = data[i] ? size : 0;
+        total += sizes[i];
+    }
+
+    img.resize(total);
+    dst = img.data();
+    memcpy(dst, sizes, IMAGE_HEADER);
+    dst += IMAGE_HEADER;
+    for (i = 0; i < IMAGE_FILES; ++i) {
+        if (sizes[i]) {
+            memcpy(dst, data[i], sizes[i]);
+            dst += sizes[i];
+        }
+    }
+}
+
+/*
+ * Find the slot files and sort them from newest to oldest.
+ */
+static int scanSlots(const char* userPath, AutosaveHeader* hdr,
+                     int* slotIndex) {
+    AutosaveHeader tmp;
+    int i, j, count = 0;
+
+    for (i = 0; i < AUTOSAVE_MAX_SLOTS; ++i) {
+        if (! readSlot(slotPath(userPath, i), &tmp, NULL))
+            continue;
+        for (j = count; j > 0 && hdr[j-1].seq < tmp.seq; --j) {
+            hdr[j] = hdr[j-1];
+            slotIndex[j] = slotIndex[j-1];
+        }
+        hdr[j] = tmp;
+        slotIndex[j] = i;
+        ++count;
+    }
+    return count;
+}
+
+/*
+ * Continue the ring from the newest slot left by a previous session.
+ */
+static void scanRing(const char* userPath) {
+    AutosaveHeader hdr[AUTOSAVE_MAX_SLOTS];
+    int slotIndex[AUTOSAVE_MAX_SLOTS];
+
+    as.seq = 0;
+    as.prevImage.clear();
+    if (scanSlots(userPath, hdr, slotIndex)) {
+        as.seq = hdr[0].seq;
+        if (hdr[0].delta ||
+            ! readSlot(slotPath(userPath, slotIndex[0]), hdr, &as.prevImage))
+            as.prevImage.clear();
+    }
+}
+
+/**
+ * Request an autosave at the end of the next turn where the game can be
+ * saved.
+ */
+void autosave_mapChanged() {
+    as.mapChanged = true;
+}
+
+/**
+ * Called at the end of each game turn to write an autosave when the
+ * autosaveTurns interval has passed or the map has changed.
+ */
+void autosave_update() {
+    const Settings* settings = xu4.settings;
+    uint32_t moves = c->saveGame->moves;
+    int slots = settings->autosaveSlots;
+
+    if (settings->autosaveTurns <= 0 || slots < 1)
+        return;
+    if (! (c->location->context & CTX_CAN_SAVE_GAME))
+        return;
+
+    if (! as.scanned) {
+        as.scanned = true;
+        as.lastMoves = moves;
+        savewriter_wait();
+        scanRing(settings->getUserPath().c_str());
+    }
+
+    if (! as.mapChanged && moves >= as.lastMoves &&
+        moves - as.lastMoves < (uint32_t) settings->autosaveTurns)
+        return;
+    as.mapChanged = false;
+    as.lastMoves = moves;
+
+    if (slots > AUTOSAVE_MAX_SLOTS)
+        slots = AUTOSAVE_MAX_SLOTS;
+
+    std::vector<uint8_t> image;
+    SaveJob* files = gamePackSave("", 0);
+    buildImage(files, image);
+    savewriter_freeJob(files);
+
+    uint32_t seq = as.seq + 1;
+    SaveJob* job = savewriter_newJob(settings->getUserPath().c_str(),
+                                     settings->saveSync);
+    if (! addSlot(job, seq % slots, seq, image.data(), image.size(), false)) {
+        savewriter_freeJob(job);
+        return;     // Try again at the next autosave.
+    }
+
+    // Replace the previous full image with a delta.  If that fails the
+    // previous slot keeps its full image, which restores just as well.
+    if (slots > 1 && as.seq && as.prevImage.size() == image.size()) {
+        std::vector<uint8_t>& prev = as.prevImage;
+        size_t i, len = prev.size();
+        for (i = 0; i < len; ++i)
+            prev[i] ^= image[i];
+        addSlot(job, as.seq % slots, as.seq, prev.data(), len, true);
+    }
+    savewriter_submit(job);
+
+    as.prevImage.swap(image);
+    as.seq = seq;
+}
+
+/**
+ * Replace the normal save files with an autosave.
+ *
+ * \param age   Zero for the newest autosave, one for the one before it, etc.
+ *
+ * \return Non-zero if successful.
+ */
+int autosave_restore(const char* userPath, int age) {
+    AutosaveHeader hdr[AUTOSAVE_MAX_SLOTS];
+    int slotIndex[AUTOSAVE_MAX_SLOTS];
+    std::vector<uint8_t> image, raw;
+    AutosaveHeader tmp;
+    uint32_t sizes[IMAGE_FILES];
+    size_t total;
+    int i, count;
+
+    savewriter_wait();
+    count = scanSlots(userPath, hdr, slotIndex);
+    if (age < 0 || age >= count || hdr[0].delta)
+        return 0;
+
+    for (i = 0; i <= age; ++i) {
+        if (hdr[i].seq != hdr[0].seq - i)
+            return 0;           // Missing slot in the chain.
+        if (! readSlot(slotPath(userPath, slotIndex[i]), &tmp, &raw))
+            return 0;
+        if (tmp.delta) {
+            size_t n, len = raw.size();
+            if (len != image.size())
+                return 0;
+            for (n = 0; n < len; ++n)
+                image[n] ^= raw[n];
+        } else
+            image.swap(raw);
+    }
+
+    if (image.size() < IMAGE_HEADER)
+        return 0;
+    memcpy(sizes, image.data(), IMAGE_HEADER);
+    total = IMAGE_HEADER;
+    for (i = 0; i < IMAGE_FILES; ++i)
+        total += sizes[i];
+    if (total != image.size() || sizes[0] != SAVEGAME_PACKED_SIZE)
+        return 0;
+
+    SaveJob* job = savewriter_newJob(userPath, xu4.settings->saveSync);
+    const uint8_t* src = image.data() + IMAGE_HEADER;
+    for (i = 0; i < IMAGE_FILES; ++i) {
+        if (sizes[i]) {
+            memcpy(savewriter_addFile(job, imageFiles[i], sizes[i]),
+                   src, sizes[i]);
+            src += sizes[i];
+        }
+    }
+    savewriter_submit(job);
+    return savewriter_wait();
+}
@@ -0,0 +1,12 @@
+/*
+ * autosave.h
+ */
+
+#ifndef AUTOSAVE_H
+#define AUTOSAVE_H
+
+void autosave_mapChanged();
+void autosave_update();
+int  autosave_restore(const char* userPath, int age);
+
+#endif /* AUTOSAVE_H */
@@ -163,7 +163,7 @@ void InnController::maybeMeetIsaac()
             Coords coords(27, xu4_random(3) + 10, c->location->coords.z);
 
             // If Isaac is already around, just bring him back to the inn
-            for (ObjectDeque::iterator i = c->location->map->objects.begin();
+            for (ObjectVector::iterator i = c->location->map->objects.begin();
                  i != c->location->map->objects.end();
                  i++) {
                 Person *p = dynamic_cast<Person*>(*i);
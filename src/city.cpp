@@ -69,7 +69,7 @@ void City::addPeople() {
  * Removes all people from the current map
  */
 void City::removeAllPeople() {
-    ObjectDeque::iterator obj;
+    ObjectVector::iterator obj;
     for (obj = objects.begin(); obj != objects.end();) {
         if (isPerson(*obj))
             obj = removeObject(obj);
@@ -317,35 +317,89 @@ void CombatController::endCombat(bool adjustKarma) {
  * hit points and creature status will be created when the creature is actually placed
  */
 void CombatController::fillCreatureTable(const Creature *creature) {
-    int i, j;
-
     if (creature != NULL) {
-        const Creature *baseCreature = creature, *current;
         int numCreatures = initialNumberOfCreatures(creature);
+        combatFillCreatureTable(xu4.randomSim, creatureTable, creature,
+                                numCreatures);
+    }
+}
 
-        if (baseCreature->getId() == PIRATE_ID)
-            baseCreature = xu4.config->creature(ROGUE_ID);
+/**
+ * Place count creatures of a group led by cr in random empty slots of a
+ * creature table (AREA_CREATURES entries).
+ */
+void combatFillCreatureTable(uint32_t* rng, const Creature** table,
+                             const Creature* cr, int count) {
+    const Creature *baseCreature = cr, *current;
+    int i, j;
 
-        for (i = 0; i < numCreatures; i++) {
-            current = baseCreature;
+    if (baseCreature->getId() == PIRATE_ID)
+        baseCreature = xu4.config->creature(ROGUE_ID);
 
-            /* find a free spot in the creature table */
-            do {j = xu4_random(AREA_CREATURES) ;} while (creatureTable[j] != NULL);
+    for (i = 0; i < count; i++) {
+        current = baseCreature;
 
-            /* see if creature is a leader or leader's leader */
-            if (xu4.config->creature(baseCreature->getLeader()) != baseCreature && /* leader is a different creature */
-                i != (numCreatures - 1)) { /* must have at least 1 creature of type encountered */
+        /* find a free spot in the creature table */
+        do {j = xu4_randomWith(rng, AREA_CREATURES) ;} while (table[j] != NULL);
 
-                if (xu4_random(32) == 0)       /* leader's leader */
-                    current = xu4.config->creature(xu4.config->creature(baseCreature->getLeader())->getLeader());
-                else if (xu4_random(8) == 0)   /* leader */
-                    current = xu4.config->creature(baseCreature->getLeader());
-            }
+        /* see if creature is a leader or leader's leader */
+        if (xu4.config->creature(baseCreature->getLeader()) != baseCreature && /* leader is a different creature */
+            i != (count - 1)) { /* must have at least 1 creature of type encountered */
 
-            /* place this creature in the creature table */
-            creatureTable[j] = current;
+            if (xu4_randomWith(rng, 32) == 0)       /* leader's leader */
+                current = xu4.config->creature(xu4.config->creature(baseCreature->getLeader())->getLeader());
+            else if (xu4_randomWith(rng, 8) == 0)   /* leader */
+                current = xu4.config->creature(baseCreature->getLeader());
         }
+
+        /* place this creature in the creature table */
+        table[j] = current;
+    }
+}
+
+/**
+ * Generate the number of creatures in a standard sized group (as met on
+ * the world map) for a party with a number of members.
+ */
+int combatEncounterSize(uint32_t* rng, const Creature* cr, int members) {
+    int ncreatures = xu4_randomWith(rng, 8) + 1;
+
+    if (ncreatures == 1) {
+        if (cr && cr->getEncounterSize() > 0)
+            ncreatures = xu4_randomWith(rng, cr->getEncounterSize()) + cr->getEncounterSize() + 1;
+        else
+            ncreatures = 8;
+    }
+
+    while (ncreatures > 2 * members) {
+        ncreatures = xu4_randomWith(rng, 16) + 1;
     }
+    return ncreatures;
+}
+
+/**
+ * Decide what a creature will do on its turn.
+ *
+ * \param state     The wound state of the creature.
+ * \param negated   True if a Negate aura is in effect.
+ */
+CombatAction combatChooseAction(uint32_t* rng, const Creature* cr,
+                                CreatureStatus state, bool negated) {
+    // creatures who teleport do so 1/8 of the time
+    if (cr->teleports() && xu4_randomWith(rng, 8) == 0)
+        return CA_TELEPORT;
+    // creatures who ranged attack do so 1/4 of the time.  Make sure
+    // their ranged attack is not negated!
+    if (cr->ranged != 0 && xu4_randomWith(rng, 4) == 0 &&
+        (cr->rangedhittile != Tile::sym.magicFlash || ! negated))
+        return CA_RANGED;
+    // creatures who cast sleep do so 1/4 of the time they don't ranged attack
+    if (cr->castsSleep() && ! negated && (xu4_randomWith(rng, 4) == 0))
+        return CA_CAST_SLEEP;
+    if (state == MSTAT_FLEEING)
+        return CA_FLEE;
+    // default action: attack (or move towards) closest target
+    return CA_ATTACK;
 }
 
 /**
@@ -358,18 +412,8 @@ int  CombatController::initialNumberOfCreatures(const Creature *creature) const
     /* if in an unusual combat situation, generally we stick to normal encounter sizes,
        (such as encounters from sleeping in an inn, etc.) */
     if (forceStandardEncounterSize || map->isWorldMap() || (c->location->prev && c->location->prev->context & CTX_DUNGEON)) {
-        ncreatures = xu4_random(8) + 1;
-
-        if (ncreatures == 1) {
-            if (creature && creature->getEncounterSize() > 0)
-                ncreatures = xu4_random(creature->getEncounterSize()) + creature->getEncounterSize() + 1;
-            else
-                ncreatures = 8;
-        }
-
-        while (ncreatures > 2 * c->saveGame->members) {
-            ncreatures = xu4_random(16) + 1;
-        }
+        ncreatures = combatEncounterSize(xu4.randomSim, creature,
+                                         c->saveGame->members);
     } else {
         if (creature && creature->getId() == GUARD_ID)
             ncreatures = c->saveGame->members * 2;
@@ -507,8 +551,8 @@ bool CombatController::attackHit(const Creature* attacker,
     ASSERT(attacker != NULL, "attacker must not be NULL");
     ASSERT(defender != NULL, "defender must not be NULL");
 
-    int attackValue = xu4_random(0x100) + attacker->getAttackBonus();
-    return attackValue > defender->getDefense();
+    return combatRollHits(xu4.randomSim, attacker->getAttackBonus(),
+                          defender->getDefense());
 }
 
 #ifdef GPU_RENDER
@@ -758,7 +802,8 @@ void CombatController::finishTurn() {
             /* put a sleeping person in place of the player,
                or restore an awakened member to their original state */
             if (player) {
-                if (player->getStatus() == STAT_SLEEPING && (xu4_random(8) == 0))
+                if (player->getStatus() == STAT_SLEEPING &&
+                    combatRollWake(xu4.randomSim))
                     player->wakeUp();
 
                 /* remove focus from the current party member */
@@ -1239,7 +1284,7 @@ void CombatController::combatNotice(int sender, void* eventData, void* user) {
     PartyEvent* event = (PartyEvent*) eventData;
     (void) sender;
     (void) user;
-    if (event->type == PartyEvent::PLAYER_KILLED)
+    if (event && event->type == PartyEvent::PLAYER_KILLED)
         screenMessage("\n%c%s is Killed!%c\n",
                       FG_RED, event->player->getName(), FG_WHITE);
 }
@@ -1253,7 +1298,7 @@ CombatMap::CombatMap() : Map(), dungeonRoom(false), altarRoom(VIRT_NONE), contex
  * Returns a vector containing all of the creatures on the map
  */
 CreatureVector CombatMap::getCreatures() {
-    ObjectDeque::iterator i;
+    ObjectVector::iterator i;
     CreatureVector creatures;
     for (i = objects.begin(); i != objects.end(); i++) {
         if (isCreature(*i) && !isPartyMember(*i))
@@ -1266,7 +1311,7 @@ CreatureVector CombatMap::getCreatures() {
  * Returns a vector containing all of the party members on the map
  */
 PartyMemberVector CombatMap::getPartyMembers() {
-    ObjectDeque::iterator i;
+    ObjectVector::iterator i;
     PartyMemberVector party;
     for (i = objects.begin(); i != objects.end(); i++) {
         if (isPartyMember(*i))
@@ -26,6 +26,12 @@ typedef enum {
     CA_TELEPORT
 } CombatAction;
 
+CombatAction combatChooseAction(uint32_t* rng, const Creature* cr,
+                                CreatureStatus state, bool negated);
+int  combatEncounterSize(uint32_t* rng, const Creature* cr, int members);
+void combatFillCreatureTable(uint32_t* rng, const Creature** table,
+                             const Creature* cr, int count);
+
 /**
  * CombatController class
  */
@@ -0,0 +1,536 @@
+/*
+ * combatsim.cpp
+ *
+ * Headless Monte-Carlo combat simulation for tuning encounters.
+ *
+ * Each fight uses its own generator & unit table so fights can be run on
+ * any thread.  The group generation, hit, damage, wound, wake, action &
+ * target choice rules are the functions used by CombatController and
+ * Creature::act() (see creature.h & combat.h), called with the fight
+ * generator.  Movement is a simple step toward (or away from) the target and
+ * the party attacks the nearest creature.  Spells, items, ranged attack
+ * effects, special creature abilities (divide, teleport, steal) and auras
+ * are not simulated.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "combat.h"
+#include "combatsim.h"
+#include "config.h"
+#include "parallel.h"
+#include "savegame.h"
+#include "tile.h"
+#include "weapon.h"
+#include "xu4.h"
+
+#ifdef USE_BORON
+extern "C" {
+void     well512_init(void* ws, uint32_t seed);
+}
+#else
+#include "well512.h"
+#endif
+
+#define SIM_TURN_LIMIT  500
+#define SIM_MAP_DIM     16      // Maximum combat map dimension.
+#define SIM_RANGED_DIST 11      // Reach of creature ranged attacks.
+
+enum SimWalk {
+    WALK_PLAYER   = 1,
+    WALK_CREATURE = 2
+};
+
+enum SimOutcome {
+    OUTCOME_DRAW,
+    OUTCOME_WIN,
+    OUTCOME_LOSS
+};
+
+struct SimUnit {
+    const Creature* proto;  // NULL for party members.
+    int16_t x, y;
+    int16_t hp;
+    int16_t basehp;
+    int16_t attackBonus;
+    int16_t defense;
+    int16_t weaponDamage;   // Party members only.
+    int16_t str;            // Party members only.
+    uint8_t range;          // Party weapon range.
+    uint8_t asleep;
+    uint8_t active;         // Zero once dead or fled.
+    uint8_t _pad;
+};
+
+struct SimFight {
+    SimUnit unit[AREA_PLAYERS + AREA_CREATURES];
+    uint32_t rng[XU4_RANDOM_STATE_LEN];
+    int partyCount;
+    int unitCount;
+};
+
+struct SimJob {
+    const Creature* creature;
+    int members;
+    int mapW, mapH;
+    uint8_t walk[SIM_MAP_DIM * SIM_MAP_DIM];
+    Coords creatureStart[AREA_CREATURES];
+    Coords playerStart[AREA_PLAYERS];
+    SimUnit party[AREA_PLAYERS];
+    uint32_t seed;
+
+    // Results for each fight.
+    int16_t* turns;
+    int16_t* damage;
+    uint8_t* deaths;
+    uint8_t* outcome;
+};
+
+/*
+ * Generate the creature group with the rules used by
+ * CombatController::fillCreatureTable() for world map encounters.
+ */
+static void simAddCreatures(const SimJob* job, SimFight* sf) {
+    const Creature* slot[AREA_CREATURES];
+    uint32_t* rng = sf->rng;
+    int j, count;
+
+    count = combatEncounterSize(rng, job->creature, job->members);
+    if (count > AREA_CREATURES)
+        count = AREA_CREATURES;
+
+    memset(slot, 0, sizeof(slot));
+    combatFillCreatureTable(rng, slot, job->creature, count);
+
+    for (j = 0; j < AREA_CREATURES; ++j) {
+        const Creature* cr = slot[j];
+        if (! cr)
+            continue;
+
+        SimUnit* su = sf->unit + sf->unitCount++;
+        su->proto  = cr;
+        su->x      = job->creatureStart[j].x;
+        su->y      = job->creatureStart[j].y;
+        su->basehp = cr->basehp;
+        su->hp     = creatureRollInitialHp(rng, cr->basehp);
+        su->attackBonus  = cr->getAttackBonus();
+        su->defense      = cr->getDefense();
+        su->weaponDamage = 0;
+        su->str          = 0;
+        su->range        = 1;
+        su->asleep       = 0;
+        su->active       = 1;
+    }
+}
+
+/*
+ * Return the distance between units as Creature::nearestOpponent() measures
+ * it on a combat map: movement distance, or diagonal distance if ranged.
+ */
+static inline int simDistance(const SimUnit* a, const SimUnit* b,
+                              bool ranged) {
+    int dx = abs(a->x - b->x);
+    int dy = abs(a->y - b->y);
+    if (ranged)
+        return (dx > dy) ? dx : dy;
+    return dx + dy;
+}
+
+static const SimUnit* simUnitAt(const SimFight* sf, int x, int y) {
+    const SimUnit* it  = sf->unit;
+    const SimUnit* end = it + sf->unitCount;
+    for (; it != end; ++it) {
+        if (it->active && it->x == x && it->y == y)
+            return it;
+    }
+    return NULL;
+}
+
+/*
+ * Find the nearest active opponent with the rule of
+ * Creature::nearestOpponent().
+ */
+static SimUnit* simNearest(SimFight* sf, const SimUnit* su, bool ranged,
+                           int* dist) {
+    SimUnit* it  = sf->unit;
+    SimUnit* end = it + sf->unitCount;
+    SimUnit* opponent = NULL;
+    int least = 0xffff;
+    bool amPlayer = (su->proto == NULL);
+
+    for (; it != end; ++it) {
+        if (! it->active || (it->proto == NULL) == amPlayer)
+            continue;
+        if (combatRollNearer(sf->rng, simDistance(it, su, ranged), &least))
+            opponent = it;
+    }
+    *dist = least;
+    return opponent;
+}
+
+/*
+ * Step one tile toward (or away from) a target.
+ * Return false if a fleeing unit leaves the map.
+ */
+static bool simStep(const SimJob* job, SimFight* sf, SimUnit* su,
+                    const SimUnit* target, bool towards) {
+    int mask = su->proto ? WALK_CREATURE : WALK_PLAYER;
+    int dx = target->x - su->x;
+    int dy = target->y - su->y;
+    int sx = (dx > 0) ? 1 : (dx < 0) ? -1 : 0;
+    int sy = (dy > 0) ? 1 : (dy < 0) ? -1 : 0;
+    int step[2][2];
+    int i, nx, ny;
+
+    if (! towards) {
+        sx = sx ? -sx : (xu4_randomWith(sf->rng, 2) ? 1 : -1);
+        sy = -sy;
+    }
+
+    // Try the axis with the greater distance first.
+    if (abs(dx) >= abs(dy)) {
+        step[0][0] = sx; step[0][1] = 0;
+        step[1][0] = 0;  step[1][1] = sy;
+    } else {
+        step[0][0] = 0;  step[0][1] = sy;
+        step[1][0] = sx; step[1][1] = 0;
+    }
+
+    for (i = 0; i < 2; ++i) {
+        if (! step[i][0] && ! step[i][1])
+            continue;
+        nx = su->x + step[i][0];
+        ny = su->y + step[i][1];
+        if (nx < 0 || ny < 0 || nx >= job->mapW || ny >= job->mapH) {
+            if (! towards)
+                return false;       // Fled off the map.
+            continue;
+        }
+        if ((job->walk[ny * SIM_MAP_DIM + nx] & mask) &&
+            ! simUnitAt(sf, nx, ny)) {
+            su->x = nx;
+            su->y = ny;
+            break;
+        }
+    }
+    return true;
+}
+
+/*
+ * Deal damage to a target with the rules of Creature::dealDamage().
+ * Return the damage dealt to party members.
+ */
+static int simDamage(const SimUnit* attacker, SimUnit* target, int damage) {
+    if (attacker->proto) {
+        int hp = playerDamageHp(target->hp, damage);
+        if (hp < 0) {
+            hp = 0;
+            target->active = 0;
+        }
+        damage = target->hp - hp;
+        target->hp = hp;
+        return damage;
+    }
+
+    target->hp = creatureDamageHp(target->proto->getId(), target->hp, damage);
+    if (creatureStateForHp(target->hp, target->basehp) == MSTAT_DEAD)
+        target->active = 0;
+    return 0;
+}
+
+/*
+ * Resolve a melee attack with the rules of CombatController::attackHit()
+ * and the getDamage() methods.  Return the damage dealt to party members.
+ */
+static int simAttack(SimFight* sf, const SimUnit* attacker, SimUnit* target) {
+    uint32_t* rng = sf->rng;
+    int damage;
+
+    if (! combatRollHits(rng, attacker->attackBonus, target->defense))
+        return 0;
+
+    if (attacker->proto)
+        damage = creatureRollDamage(rng, attacker->basehp);
+    else
+        damage = playerRollDamage(rng, attacker->weaponDamage, attacker->str);
+    return simDamage(attacker, target, damage);
+}
+
+static inline bool simAligned(const SimUnit* a, const SimUnit* b) {
+    int dx = abs(a->x - b->x);
+    int dy = abs(a->y - b->y);
+    return dx == 0 || dy == 0 || dx == dy;
+}
+
+static void simPartyTurn(const SimJob* job, SimFight* sf, SimUnit* su) {
+    SimUnit* target;
+    int dist;
+
+    if (su->asleep) {
+        if (combatRollWake(sf->rng))
+            su->asleep = 0;
+        return;
+    }
+
+    target = simNearest(sf, su, false, &dist);
+    if (! target)
+        return;
+
+    // Attacks are made in one of the four cardinal directions.
+    if ((su->x == target->x || su->y == target->y) && dist <= su->range)
+        simAttack(sf, su, target);
+    else
+        simStep(job, sf, su, target, true);
+}
+
+/*
+ * Take a creature turn following Creature::act().
+ * Return the damage dealt to party members.
+ */
+static int simCreatureTurn(const SimJob* job, SimFight* sf, SimUnit* su) {
+    CombatAction action;
+    SimUnit* target;
+    int dist, i;
+
+    if (su->asleep) {
+        if (combatRollWake(sf->rng))
+            su->asleep = 0;
+        else
+            return 0;
+    }
+
+    action = combatChooseAction(sf->rng, su->proto,
+                                creatureStateForHp(su->hp, su->basehp), false);
+
+    target = simNearest(sf, su, action == CA_RANGED, &dist);
+    if (! target)
+        return 0;
+
+    if (action == CA_ATTACK && dist > 1)
+        action = CA_ADVANCE;
+
+    switch (action) {
+    case CA_ATTACK:
+        return simAttack(sf, su, target);
+
+    case CA_CAST_SLEEP:
+        for (i = 0; i < sf->partyCount; ++i) {
+            if (sf->unit[i].active && xu4_randomWith(sf->rng, 2) == 0)
+                sf->unit[i].asleep = 1;
+        }
+        break;
+
+    case CA_RANGED:
+        // Ranged attacks never miss but only travel in the eight directions.
+        if (simAligned(su, target) && dist <= SIM_RANGED_DIST)
+            return simDamage(su, target,
+                             creatureRollDamage(sf->rng, su->basehp));
+        break;
+
+    case CA_FLEE:
+        if (! simStep(job, sf, su, target, false))
+            su->active = 0;
+        break;
+
+    case CA_ADVANCE:
+        simStep(job, sf, su, target, true);
+        break;
+
+    default:
+        break;
+    }
+    return 0;
+}
+
+static void simFight(void* user, int index) {
+    const SimJob* job = (const SimJob*) user;
+    SimFight sf;
+    int turn, i, partyLeft, creaturesLeft, damage;
+
+    well512_init(sf.rng, job->seed + index * 0x9e3779b9);
+
+    sf.partyCount = job->members;
+    memcpy(sf.unit, job->party, sizeof(SimUnit) * job->members);
+    sf.unitCount = job->members;
+    simAddCreatures(job, &sf);
+
+    damage = 0;
+    partyLeft = creaturesLeft = 0;
+    for (turn = 1; turn <= SIM_TURN_LIMIT; ++turn) {
+        for (i = 0; i < sf.partyCount; ++i) {
+            if (sf.unit[i].active)
+                simPartyTurn(job, &sf, sf.unit + i);
+        }
+        for (; i < sf.unitCount; ++i) {
+            if (sf.unit[i].active)
+                damage += simCreatureTurn(job, &sf, sf.unit + i);
+        }
+
+        partyLeft = creaturesLeft = 0;
+        for (i = 0; i < sf.unitCount; ++i) {
+            if (sf.unit[i].active) {
+                if (i < sf.partyCount)
+                    ++partyLeft;
+                else
+                    ++creaturesLeft;
+            }
+        }
+        if (! partyLeft || ! creaturesLeft)
+            break;
+    }
+
+    job->turns[index]  = (turn > SIM_TURN_LIMIT) ? SIM_TURN_LIMIT : turn;
+    job->damage[index] = damage;
+    job->deaths[index] = sf.partyCount - partyLeft;
+    if (! partyLeft)
+        job->outcome[index] = OUTCOME_LOSS;
+    else if (! creaturesLeft)
+        job->outcome[index] = OUTCOME_WIN;
+    else
+        job->outcome[index] = OUTCOME_DRAW;
+}
+
+/*
+ * Sort values and return the mean, 50th & 95th percentile.
+ */
+static float simStats(int16_t* val, int count, int* p50, int* p95) {
+    double sum = 0.0;
+    int i;
+
+    for (i = 0; i < count; ++i)
+        sum += val[i];
+    std::sort(val, val + count);
+    *p50 = val[(count - 1) * 50 / 100];
+    *p95 = val[(count - 1) * 95 / 100];
+    return (float) (sum / count);
+}
+
+/**
+ * Run a number of independent fights between the party and a group of
+ * creatures on a combat map, spread over all cores.
+ *
+ * \param party     SaveGame holding the party members (dead members are
+ *                  left out).
+ * \param creature  Creature type encountered.
+ * \param mapId     Combat map (e.g. from GameController::combatMapForTile).
+ * \param seed      The random seed for fight N is derived from seed + N so
+ *                  results do not depend on the number of threads.
+ *
+ * \return Non-zero if successful.
+ */
+int combatsim_run(const SaveGame* party, const Creature* creature,
+                  MapId mapId, int fights, uint32_t seed,
+                  CombatSimResult* result) {
+    SimJob* job;
+    CombatMap* cmap;
+    int i;
+
+    memset(result, 0, sizeof(CombatSimResult));
+
+    cmap = getCombatMap(xu4.config->map(mapId));
+    if (! cmap || cmap->width > SIM_MAP_DIM || cmap->height > SIM_MAP_DIM ||
+        fights < 1)
+        return 0;
+
+    job = new SimJob;
+    job->creature = creature;
+    job->seed = seed;
+    job->mapW = cmap->width;
+    job->mapH = cmap->height;
+    memcpy(job->creatureStart, cmap->creature_start, sizeof(job->creatureStart));
+    memcpy(job->playerStart, cmap->player_start, sizeof(job->playerStart));
+
+    // Gather map walkability as tileTypeAt() is not needed by the fights.
+    {
+    Coords pos(0, 0, 0);
+    for (pos.y = 0; pos.y < job->mapH; ++pos.y) {
+        for (pos.x = 0; pos.x < job->mapW; ++pos.x) {
+            const Tile* tile = cmap->tileTypeAt(pos, WITHOUT_OBJECTS);
+            uint8_t mask = 0;
+            if (tile->isWalkable())
+                mask |= WALK_PLAYER;
+            if (tile->isCreatureWalkable())
+                mask |= WALK_CREATURE;
+            job->walk[pos.y * SIM_MAP_DIM + pos.x] = mask;
+        }
+    }
+    }
+
+    job->members = 0;
+    for (i = 0; i < party->members && i < AREA_PLAYERS; ++i) {
+        const SaveGamePlayerRecord* pr = party->players + i;
+        const Weapon* weapon;
+        SimUnit* su;
+
+        if (pr->status == STAT_DEAD)
+            continue;
+
+        weapon = xu4.config->weapon(pr->weapon);
+        su = job->party + job->members;
+        su->proto  = NULL;
+        su->x      = job->playerStart[job->members].x;
+        su->y      = job->playerStart[job->members].y;
+        su->hp     = pr->hp;
+        su->basehp = pr->hpMax;
+        su->attackBonus  = (weapon->alwaysHits() || pr->dex >= 40) ? 255 : pr->dex;
+        su->defense      = xu4.config->armor(pr->armor)->defense;
+        su->weaponDamage = weapon->damage;
+        su->str          = pr->str;
+        su->range        = weapon->range ? weapon->range : 1;
+        su->asleep       = (pr->status == STAT_SLEEPING);
+        su->active       = 1;
+        ++job->members;
+    }
+
+    if (! job->members) {
+        delete job;
+        return 0;
+    }
+
+    job->turns   = new int16_t[fights];
+    job->damage  = new int16_t[fights];
+    job->deaths  = new uint8_t[fights];
+    job->outcome = new uint8_t[fights];
+
+    parallel_for(fights, simFight, job);
+
+    result->fights = fights;
+    for (i = 0; i < fights; ++i) {
+        if (job->outcome[i] == OUTCOME_WIN)
+            ++result->wins;
+        else if (job->outcome[i] == OUTCOME_LOSS)
+            ++result->losses;
+        result->deathsMean += job->deaths[i];
+    }
+    result->deathsMean /= fights;
+    result->turnsMean  = simStats(job->turns, fights, &result->turnsP50,
+                                  &result->turnsP95);
+    result->damageMean = simStats(job->damage, fights, &result->damageP50,
+                                  &result->damageP95);
+
+    delete[] job->turns;
+    delete[] job->damage;
+    delete[] job->deaths;
+    delete[] job->outcome;
+    delete job;
+    return 1;
+}
+
+void combatsim_print(const CombatSimResult* res) {
+    printf("fights %d\n"
+           "win  %6.2f%%\n"
+           "loss %6.2f%%\n"
+           "           mean    p50    p95\n"
+           "turns  %7.2f %6d %6d\n"
+           "damage %7.2f %6d %6d\n"
+           "deaths %7.2f\n",
+           res->fights,
+           100.0f * res->wins / res->fights,
+           100.0f * res->losses / res->fights,
+           res->turnsMean, res->turnsP50, res->turnsP95,
+           res->damageMean, res->damageP50, res->damageP95,
+           res->deathsMean);
+}
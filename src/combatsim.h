@@ -0,0 +1,31 @@
+/*
+ * combatsim.h
+ */
+
+#ifndef COMBATSIM_H
+#define COMBATSIM_H
+
+#include "types.h"
+
+class Creature;
+struct SaveGame;
+
+struct CombatSimResult {
+    int fights;
+    int wins;           // All creatures killed or fled.
+    int losses;         // Whole party killed.
+    float turnsMean;    // Rounds per fight.
+    int   turnsP50;
+    int   turnsP95;
+    float damageMean;   // Party hit points lost per fight.
+    int   damageP50;
+    int   damageP95;
+    float deathsMean;   // Party members killed per fight.
+};
+
+int  combatsim_run(const SaveGame* party, const Creature* creature,
+                   MapId mapId, int fights, uint32_t seed,
+                   CombatSimResult* result);
+void combatsim_print(const CombatSimResult* result);
+
+#endif /* COMBATSIM_H */
@@ -20,6 +20,7 @@
 #include "map.h"
 #include "module.h"
 #include "portal.h"
+#include "savewriter.h"
 #include "screen.h"
 #include "settings.h"
 #include "shrine.h"
@@ -1077,7 +1078,7 @@ ConfigBoron::ConfigBoron(const char* renderPath, const char* modulePath,
         for (moduleId = 0; moduleId < tileCount; ++moduleId) {
             if (! conf_tile(this, tile, moduleId, bi))
                 break;
-            ts->nameMap[tile->name] = tile;     // Add tile to nameMap
+            ts->setName(tile->name, tile);
             ++tile;
         }
         ts->tileCount = moduleId;
@@ -1483,6 +1484,7 @@ Map* Config::restoreMap(uint32_t id) {
 
         if (rmap->type == Map::DUNGEON) {
             std::string path(xu4.settings->getUserPath() + DNGMAP_SAV);
+            savewriter_wait();
             sav = fopen(path.c_str(), "rb");
         }
         ok = loadMap(rmap, sav);
@@ -1710,7 +1712,7 @@ float* Config::newDrawList(Symbol name, int* plen) const {
 
                 ++bi.it;
                 ur_blockIt(CX->ut, &ai, bi.it);
-                len = (ai.end - ai.it) * 7 * 6;
+                len = (ai.end - ai.it) * 7 * 4;     // 4 vertices per quad.
                 attr = attrBuf = (float*) malloc(len * sizeof(float));
 
                 ur_foreach(ai) {
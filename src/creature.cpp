@@ -61,19 +61,16 @@ bool Creature::isAttackable() const  {
 }
 
 int Creature::getDamage() const {
-    int x = xu4_random(basehp >> 2);
-    return (x >> 4) * 10 + (x % 10);
+    return creatureRollDamage(xu4.randomSim, basehp);
 }
 
 int Creature::setInitialHp(int points) {
     if (points < 0)
-        hp = xu4_random(basehp) | (basehp / 2);
+        hp = creatureRollInitialHp(xu4.randomSim, basehp);
+    else if (points < 24)
+        hp = 24;    /* make sure the creature doesn't flee initially */
     else
         hp = points;
-
-    /* make sure the creature doesn't flee initially */
-    if (hp < 24) hp = 24;
-
     return hp;
 }
 
@@ -82,6 +79,10 @@ void Creature::setRandomRanged() {
 }
 
 CreatureStatus Creature::getState() const {
+    return creatureStateForHp(hp, basehp);
+}
+
+CreatureStatus creatureStateForHp(int hp, int basehp) {
     int heavy_threshold, light_threshold, crit_threshold;
 
     crit_threshold = basehp >> 2;  /* (basehp / 4) */
@@ -100,7 +101,46 @@ CreatureStatus Creature::getState() const {
         return MSTAT_LIGHTLYWOUNDED;
     else
         return MSTAT_BARELYWOUNDED;
+}
+
+// Return true if an attack hits.
+bool combatRollHits(uint32_t* rng, int attackBonus, int defense) {
+    return xu4_randomWith(rng, 0x100) + attackBonus > defense;
+}
+
+// Return true if a sleeping creature or party member wakes up this turn.
+bool combatRollWake(uint32_t* rng) {
+    return xu4_randomWith(rng, 8) == 0;
+}
+
+/*
+ * Return true if an opponent at dist should replace the one at leastDist
+ * as the nearest.  Equally distant opponents are chosen half of the time.
+ */
+bool combatRollNearer(uint32_t* rng, int dist, int* leastDist) {
+    if (dist < *leastDist ||
+        (dist == *leastDist && xu4_randomWith(rng, 2) == 0)) {
+        *leastDist = dist;
+        return true;
+    }
+    return false;
+}
 
+int creatureRollDamage(uint32_t* rng, int basehp) {
+    int roll = xu4_randomWith(rng, basehp >> 2);
+    return (roll >> 4) * 10 + (roll % 10);
+}
+
+int creatureRollInitialHp(uint32_t* rng, int basehp) {
+    int hp = xu4_randomWith(rng, basehp) | (basehp / 2);
+
+    /* make sure the creature doesn't flee initially */
+    return (hp < 24) ? 24 : hp;
+}
+
+int playerRollDamage(uint32_t* rng, int weaponDamage, int str) {
+    int maxDamage = weaponDamage + str;
+    return xu4_randomWith(rng, (maxDamage > 255) ? 255 : maxDamage);
 }
 
 /**
@@ -197,7 +237,7 @@ bool Creature::specialEffect() {
 
     case STORM_ID:
         {
-            ObjectDeque::iterator i;
+            ObjectVector::iterator i;
 
             if (coords == c->location->coords) {
                 if (c->transportContext == TRANSPORT_BALLOON)
@@ -243,7 +283,7 @@ bool Creature::specialEffect() {
 
     case WHIRLPOOL_ID:
         {
-            ObjectDeque::iterator i;
+            ObjectVector::iterator i;
             Map* map = c->location->map;
 
             if (coords == c->location->coords &&
@@ -306,9 +346,10 @@ void Creature::act(CombatController *controller) {
     CombatAction action;
     Creature *target;
     CombatMap* map = controller->getMap();
+    uint32_t* rng = xu4.randomSim;
 
     /* see if creature wakes up if it is asleep */
-    if ((getStatus() == STAT_SLEEPING) && (xu4_random(8) == 0))
+    if ((getStatus() == STAT_SLEEPING) && combatRollWake(rng))
         wakeUp();
 
     /* if the creature is still asleep, then do nothing */
@@ -321,23 +362,8 @@ void Creature::act(CombatController *controller) {
     /*
      * figure out what to do
      */
-
-    // creatures who teleport do so 1/8 of the time
-    if (teleports() && xu4_random(8) == 0)
-        action = CA_TELEPORT;
-    // creatures who ranged attack do so 1/4 of the time.  Make sure
-    // their ranged attack is not negated!
-    else if (ranged != 0 && xu4_random(4) == 0 &&
-             (rangedhittile != Tile::sym.magicFlash || (c->aura.getType() != Aura::NEGATE)))
-        action = CA_RANGED;
-    // creatures who cast sleep do so 1/4 of the time they don't ranged attack
-    else if (castsSleep() && (c->aura.getType() != Aura::NEGATE) && (xu4_random(4) == 0))
-        action = CA_CAST_SLEEP;
-    else if (getState() == MSTAT_FLEEING)
-        action = CA_FLEE;
-    // default action: attack (or move towards) closest target
-    else
-        action = CA_ATTACK;
+    action = combatChooseAction(rng, this, getState(),
+                                c->aura.getType() == Aura::NEGATE);
 
     /*
      * now find out who to do it to
@@ -562,8 +588,9 @@ bool Creature::hideOrShow(Map* map) {
 Creature *Creature::nearestOpponent(Map* map, int *dist, bool ranged) const {
     Creature *opponent = NULL;
     int d, leastDist = 0xFFFF;
-    ObjectDeque::iterator i;
+    ObjectVector::iterator i;
     bool jinx = (c->aura.getType() == Aura::JINX);
+    uint32_t* rng = xu4.randomSim;
 
     for (i = map->objects.begin(); i < map->objects.end(); i++) {
         if (!isCreature(*i))
@@ -585,10 +612,8 @@ Creature *Creature::nearestOpponent(Map* map, int *dist, bool ranged) const {
                 d = map_movementDistance(objCoords, coords);
 
             /* skip target 50% of time if same distance */
-            if (d < leastDist || (d == leastDist && xu4_random(2) == 0)) {
+            if (combatRollNearer(rng, d, &leastDist))
                 opponent = dynamic_cast<Creature*>(*i);
-                leastDist = d;
-            }
         }
     }
 
@@ -686,8 +711,7 @@ void Creature::wakeUp() {
  */
 bool Creature::applyDamage(Map* map, int damage, bool byplayer) {
     /* deal the damage */
-    if (id != LORDBRITISH_ID)
-        AdjustValueMin(hp, -damage, 0);
+    hp = creatureDamageHp(id, hp, damage);
 
     const char* nameStr = CSTR(name);
 
@@ -243,6 +243,35 @@ public:
     uint16_t        status;
 };
 
+/*
+ * Combat rules which draw from an explicit random number generator state
+ * (such as xu4.randomSim) so they are shared by the game and the combat
+ * simulator (combatsim.cpp).
+ */
+
+bool combatRollHits(uint32_t* rng, int attackBonus, int defense);
+bool combatRollWake(uint32_t* rng);
+bool combatRollNearer(uint32_t* rng, int dist, int* leastDist);
+int  creatureRollDamage(uint32_t* rng, int basehp);
+int  creatureRollInitialHp(uint32_t* rng, int basehp);
+int  playerRollDamage(uint32_t* rng, int weaponDamage, int str);
+
+// Return the hit points left after damage.  Lord British cannot be hurt.
+inline int creatureDamageHp(CreatureId id, int hp, int damage) {
+    if (id == LORDBRITISH_ID)
+        return hp;
+    hp -= damage;
+    return (hp < 0) ? 0 : hp;
+}
+
+// Return the hit points left after damage or -1 if the party member dies.
+inline int playerDamageHp(int hp, int damage) {
+    hp -= damage;
+    return (hp < 0) ? -1 : hp;
+}
+
+CreatureStatus creatureStateForHp(int hp, int basehp);
+
 bool isCreature(Object *punknown);
 
 #endif
@@ -3,6 +3,7 @@
  */
 
 #include <assert.h>
+#include <string.h>
 #include "context.h"
 #include "debug.h"
 #include "dungeon.h"
@@ -32,9 +33,28 @@ DungeonView::DungeonView(int x, int y, int columns, int rows) : TileView(x, y, r
     down_ladder   = tileset->getByName(SYM_DOWN_LADDER)->getId();
     updown_ladder = tileset->getByName(SYM_UP_DOWN_LADDER)->getId();
 
+    viewCacheNext = 0;
+    memset(viewCache, 0, sizeof(viewCache));
+
     cacheGraphicData();
 }
 
+DungeonView::~DungeonView() {
+    flushViewCache();
+}
+
+/*
+ * Free the composited views. This must be called whenever the wall
+ * graphics change.
+ */
+void DungeonView::flushViewCache() {
+    for (int i = 0; i < DNG_VIEW_CACHE; ++i) {
+        delete viewCache[i].image;
+        viewCache[i].image = NULL;
+    }
+    viewCacheNext = 0;
+}
+
 /*
  * Sets coords relative to party and fills tiles from that location.
  */
@@ -90,61 +110,121 @@ void DungeonView::display(Context * c, TileView *view)
         //Note: This shouldn't go above 4, unless we check opaque tiles each step of the way.
         const int farthest_non_wall_tile_visibility = 4;
 
-        screenEraseMapArea();
-        if (c->party->getTorchDuration() > 0) {
-            vector<MapTile> distant_tiles;
+        if (c->party->getTorchDuration() <= 0) {
+            screenEraseMapArea();
+            return;
+        }
 
-            for (y = 3; y >= 0; y--) {
-                DungeonGraphicType type;
-                Direction dir = (Direction) c->saveGame->orientation;
+        Direction dir = (Direction) c->saveGame->orientation;
+        DungeonGraphicType type;
+        MapTile sprite[farthest_non_wall_tile_visibility + 1];
+        bool hasSprite[farthest_non_wall_tile_visibility + 1] = { false };
+        int8_t wall[4*3];
+        int spriteCount = 0;
+
+        // Gather the wall graphics & tiles of the visible cells.
+        for (y = 3; y >= 0; y--) {
+            for (x = 0; x < 3; ++x) {
+                dungeonGetTiles(drawLoc, tiles, y, wallSides[x]);
+                type = tilesToGraphic(dungeon, tiles);
+                wall[y*3 + x] = graphicIndex(drawLoc, wallSides[x], y, dir,
+                                             type);
+            }
 
-                // Draw walls player can see.
-                Image::enableBlend(1);
-                for (x = 0; x < 3; ++x) {
-                    dungeonGetTiles(drawLoc, tiles, y, wallSides[x]);
+            // The last cell fetched is the center one.
+            hasSprite[y] = (type == DNGGRAPHIC_DNGTILE ||
+                            type == DNGGRAPHIC_BASETILE);
+            if (hasSprite[y]) {
+                sprite[y] = tiles.front();
+                ++spriteCount;
+            }
+
+            //This only checks that the tile at y==3 is opaque
+            if (y == 3) {
+                bool seeFar = ! tiles.front().getTileType()->isOpaque();
+                for (int y_obj = farthest_non_wall_tile_visibility; y_obj > y; y_obj--)
+                {
+                    hasSprite[y_obj] = false;
+                    if (! seeFar)
+                        continue;
+                    dungeonGetTiles(drawLoc, tiles, y_obj, 0);
                     type = tilesToGraphic(dungeon, tiles);
-                    drawWall(graphicIndex(drawLoc, wallSides[x], y, dir, type));
+                    if ((type == DNGGRAPHIC_DNGTILE) ||
+                        (type == DNGGRAPHIC_BASETILE)) {
+                        hasSprite[y_obj] = true;
+                        sprite[y_obj] = tiles.front();
+                        ++spriteCount;
+                    }
+                }
+            }
+        }
+
+        // Views with only walls are static and can be re-used.
+        ViewCache* vc;
+        if (! spriteCount) {
+            for (x = 0; x < DNG_VIEW_CACHE; ++x) {
+                vc = viewCache + x;
+                if (vc->image && memcmp(vc->wall, wall, sizeof(wall)) == 0) {
+                    vc->image->draw(BORDER_WIDTH, BORDER_HEIGHT);
+                    return;
                 }
-                Image::enableBlend(0);
+            }
+        }
+
+        screenEraseMapArea();
+        for (y = 3; y >= 0; y--) {
+            drawWallRow(wall + y*3);
 
-                //This only checks that the tile at y==3 is opaque
-                if (y == 3 && !tiles.front().getTileType()->isOpaque())
+            if (y == 3) {
+                for (int y_obj = farthest_non_wall_tile_visibility; y_obj > y; y_obj--)
                 {
-                    for (int y_obj = farthest_non_wall_tile_visibility; y_obj > y; y_obj--)
-                    {
-                    dungeonGetTiles(drawLoc, distant_tiles, y_obj, 0);
-                    DungeonGraphicType distant_type =
-                        tilesToGraphic(dungeon, distant_tiles);
-
-                    if ((distant_type == DNGGRAPHIC_DNGTILE) ||
-                        (distant_type == DNGGRAPHIC_BASETILE))
-                        drawInDungeon(distant_tiles.front(), 0, y_obj, dir);
-                    }
+                    if (hasSprite[y_obj])
+                        drawInDungeon(sprite[y_obj], 0, y_obj, dir);
                 }
-                if ((type == DNGGRAPHIC_DNGTILE) ||
-                    (type == DNGGRAPHIC_BASETILE))
-                    drawInDungeon(tiles.front(), 0, y, dir);
             }
+            if (hasSprite[y])
+                drawInDungeon(sprite[y], 0, y, dir);
+        }
+
+        if (! spriteCount) {
+            const int w = VIEWPORT_W * TILE_WIDTH;
+            const int h = VIEWPORT_H * TILE_HEIGHT;
+
+            vc = viewCache + viewCacheNext;
+            if (++viewCacheNext == DNG_VIEW_CACHE)
+                viewCacheNext = 0;
+            if (! vc->image)
+                vc->image = Image::create(w, h);
+            image32_blitRect(vc->image, 0, 0, xu4.screenImage,
+                             BORDER_WIDTH, BORDER_HEIGHT, w, h, 0);
+            memcpy(vc->wall, wall, sizeof(wall));
         }
+        return;
     }
 
     /* 3rd-person perspective */
-    else {
-        for (y = 0; y < VIEWPORT_H; y++) {
-            for (x = 0; x < VIEWPORT_W; x++) {
-                dungeonGetTiles(drawLoc, tiles,
-                                (VIEWPORT_H / 2) - y, x - (VIEWPORT_W / 2));
-
-                /* Only show blackness if there is no light */
-                if (c->party->getTorchDuration() <= 0)
-                    view->drawTile(black, x, y);
-                else if (x == VIEWPORT_W/2 && y == VIEWPORT_H/2)
-                    view->drawTile(avatar, x, y);
-                else
-                    view->drawTile(tiles, x, y);
-            }
+#ifdef GPU_RENDER
+    /* Only show blackness if there is no light */
+    if (c->party->getTorchDuration() <= 0)
+        screenEraseMapArea();
+    else
+        screenUpdateMap(view, c->location->map, c->location->coords);
+#else
+    for (y = 0; y < VIEWPORT_H; y++) {
+        for (x = 0; x < VIEWPORT_W; x++) {
+            dungeonGetTiles(drawLoc, tiles,
+                            (VIEWPORT_H / 2) - y, x - (VIEWPORT_W / 2));
+
+            /* Only show blackness if there is no light */
+            if (c->party->getTorchDuration() <= 0)
+                view->drawTile(black, x, y);
+            else if (x == VIEWPORT_W/2 && y == VIEWPORT_H/2)
+                view->drawTile(avatar, x, y);
+            else
+                view->drawTile(tiles, x, y);
         }
     }
+#endif
 }
 
 void DungeonView::drawInDungeon(const MapTile& mt, int x_offset, int distance, Direction orientation) {
@@ -447,6 +527,8 @@ void DungeonView::cacheGraphicData() {
     Symbol name;
     int i;
 
+    flushViewCache();
+
     for (i = 0; i < GRAPHIC_COUNT; ++i) {
         name = xu4.config->intern(dngGraphicInfo[i].imageName);
         graphic[i].info = xu4.imageMgr->imageInfo(name, &graphic[i].sub);
@@ -467,6 +549,13 @@ static void drawGraphic(const ImageInfo* info, const SubImage* subimage,
         info->image->draw(x, y);
 }
 
+void DungeonView::drawWallRow(const int8_t* wall) {
+    Image::enableBlend(1);
+    for (int x = 0; x < 3; ++x)
+        drawWall(wall[x]);
+    Image::enableBlend(0);
+}
+
 void DungeonView::drawWall(int index) {
     const SubImage* subimage;
     int x, y;
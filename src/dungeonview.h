@@ -19,14 +19,18 @@ typedef enum {
     DNGGRAPHIC_TRAP
 } DungeonGraphicType;
 
+#define DNG_VIEW_CACHE  8       // Number of composited wall views kept.
+
 class Context;
 class Dungeon;
+class Image;
 class ImageInfo;
 class SubImage;
 
 class DungeonView : public TileView {
 public:
     DungeonView(int x, int y, int columns, int rows);
+    ~DungeonView();
 
     void cacheGraphicData();
     void display(Context * c, TileView *view);
@@ -44,12 +48,21 @@ private:
     DungeonGraphicType tilesToGraphic(const Dungeon*,
                                       const std::vector<MapTile> &tiles);
     void drawWall(int graphic);
+    void drawWallRow(const int8_t* wall);
+    void flushViewCache();
 
     struct GraphicData {
         const ImageInfo* info;
         const SubImage* sub;
     };
 
+    // A first-person view with only walls (no tiles) is fully defined by
+    // the graphic index of the 4x3 visible cells.
+    struct ViewCache {
+        Image* image;
+        int8_t wall[4*3];
+    };
+
     MapTile black;
     MapTile avatar;
     TileId corridor;
@@ -60,7 +73,9 @@ private:
     uint32_t spotTrapTime;
     bool screen3dDungeonViewEnabled;
     bool egaGraphics;
+    int      viewCacheNext;
     GraphicData graphic[84];
+    ViewCache viewCache[DNG_VIEW_CACHE];
 };
 
 #endif /* DUNGEONVIEW_H */
@@ -15,20 +15,24 @@
 #include "savegame.h"
 #include "screen.h"
 #include "sound.h"
+#include "telemetry.h"
 #include "textview.h"
 #include "u4.h"
 #include "xu4.h"
 
 using std::string;
 
-static void frameSleepInit(FrameSleep* fs, int frameDuration) {
-    fs->frameInterval = frameDuration;
-    fs->realTime = 0;
-    for (int i = 0; i < 8; ++i)
-        fs->ftime[i] = frameDuration;
-    fs->ftimeSum = frameDuration * 8;
-    fs->ftimeIndex = 0;
-    fs->fsleep = frameDuration - 6;
+static void framePacerInit(FramePacer* fp, int frameDuration) {
+    fp->frameInterval = frameDuration;
+    fp->frameUsec = frameDuration * 1000;
+    fp->deadline = 0;
+    fp->stepTime = 0;
+    fp->frameStart = 0;
+    fp->lastPresent = 0;
+    fp->spinUsec = 1000;
+    fp->swapBound = 0;
+    fp->skipped = 0;
+    memset(&fp->stats, 0, sizeof(FrameStats));
 }
 
 /**
@@ -42,7 +46,7 @@ EventHandler::EventHandler(int gameCycleDuration, int frameDuration) :
     controllerDone = ended = false;
     anim_init(&flourishAnim, 64, NULL, NULL);
     anim_init(&fxAnim, 32, NULL, NULL);
-    frameSleepInit(&fs, frameDuration);
+    framePacerInit(&fp, frameDuration);
 
 #ifdef DEBUG
     recordFP = -1;
@@ -152,61 +156,148 @@ void EventHandler::setScreenUpdate(void (*updateFunc)(void)) {
 
 #include "support/getTicks.c"
 
+#define FP_SWAP_BOUND   8       // Frames before deferring to swap pacing.
+#define FP_SPIN_MIN     200     // Minimum busy-wait margin (usec).
+#define FP_SPIN_MAX     4000
+
+// Exponential moving average with a weight of 1/16 for new samples.
+#define EMA(avg, sample)    avg += ((sample) - avg) * 0.0625f
+
 /*
- * Return non-zero if waitTime has been reached or passed.
+ * Begin timing of a new run loop.
  */
-static int frameSleep(FrameSleep* fs, uint32_t waitTime) {
-    uint32_t now;
-    int32_t elapsed, elapsedLimit, frameAdjust;
-    int i;
+static void framePacerReset(FramePacer* fp) {
+    int64_t now = usecTicks();
+    fp->deadline = fp->stepTime = fp->lastPresent = now;
+    fp->skipped = 0;
+}
 
-    now = getTicks();
-    elapsed = now - fs->realTime;
-    fs->realTime = now;
-
-    elapsedLimit = fs->frameInterval * 8;
-    if (elapsed > elapsedLimit)
-        elapsed = elapsedLimit;
-
-    i = fs->ftimeIndex;
-    fs->ftimeSum += elapsed - fs->ftime[i];
-    fs->ftime[i] = elapsed;
-    fs->ftimeIndex = i ? i - 1 : FS_SAMPLES - 1;
-
-    frameAdjust = int(fs->frameInterval) - fs->ftimeSum / FS_SAMPLES;
-#if 0
-    // Adjust by 1 msec.
-    if (frameAdjust > 0) {
-        if (fs->fsleep < fs->frameInterval - 1)
-            ++fs->fsleep;
-    } else if (frameAdjust < 0) {
-        if (fs->fsleep)
-            --fs->fsleep;
+/*
+ * Advance the game step clock by one frame and decide if the step should
+ * be rendered.
+ *
+ * Game steps (input handling & timer ticks) always advance by frameInterval
+ * so that the simulation remains deterministic.  If rendering falls behind
+ * real time (e.g. a GPU stall or vsync miss) then up to FP_MAX_SKIP frames
+ * are dropped so the game can catch up without being slowed down.
+ *
+ * Rendering stays on this thread rather than a separate one fed by render
+ * snapshots: the GL context belongs to the window on the main thread, the
+ * render layers read live map views & tile animations, and wait_msecs()
+ * re-enters this loop from the middle of game logic where there is no
+ * consistent state to hand off.
+ *
+ * Return non-zero if framePresent() & framePace() should be called.
+ */
+static int frameStep(FramePacer* fp) {
+    int64_t behind;
+    int64_t interval = fp->frameInterval * 1000;
+
+    fp->stepTime += interval;
+    if (xu4.headless)
+        return 1;       // Offscreen frames are never skipped.
+
+    behind = usecTicks() - fp->stepTime;
+    if (behind > interval) {
+        if (fp->skipped < FP_MAX_SKIP) {
+            ++fp->skipped;
+            ++fp->stats.skipped;
+            return 0;
+        }
+        // Too far behind to catch up; drop the missed time.
+        fp->stepTime += behind;
+    } else if (behind < -interval) {
+        // Don't let the step clock run ahead and hide later stalls.
+        fp->stepTime += behind + interval;
     }
-#else
-    // Adjust by 2 msec.
-    if (frameAdjust > 0) {
-        if (frameAdjust > 2)
-            frameAdjust = 2;
-        int sa = int(fs->fsleep) + frameAdjust;
-        int limit = fs->frameInterval - 1;
-        fs->fsleep = (sa > limit) ? limit : sa;
-    } else if (frameAdjust < 0) {
-        if (frameAdjust < -2)
-            frameAdjust = -2;
-        int sa = int(fs->fsleep) + frameAdjust;
-        fs->fsleep = (sa < 0) ? 0 : sa;
+    fp->skipped = 0;
+    return 1;
+}
+
+/*
+ * Render and display a frame, measuring how long the present takes.
+ */
+static void framePresent(FramePacer* fp) {
+    fp->frameStart = usecTicks();
+    {
+    TELE_SCOPE(TZ_SWAP);
+    screenSwapBuffers();
     }
-#endif
+}
+
+/*
+ * Wait until the next frame deadline.
+ *
+ * The wait sleeps until shortly before the deadline and then spins to hit
+ * it precisely.  The spin margin adapts to the measured sleep overshoot.
+ * If the buffer swap itself consistently takes most of the frame (vsync
+ * with a display slower than the frame interval, or a GPU bound frame),
+ * then pacing is left to the swap and no extra wait is added.
+ *
+ * Return non-zero if waitUntil has been reached or passed.
+ */
+static int framePace(FramePacer* fp, int64_t waitUntil) {
+    FrameStats* st = &fp->stats;
+    int64_t now = usecTicks();
+    int64_t present = now - fp->frameStart;
+    int64_t remain;
+
+    ++st->frames;
+    EMA(st->presentMsec, present * 0.001f);
+    EMA(st->frameMsec, (now - fp->lastPresent) * 0.001f);
+    if (xu4.telemetry) {
+        tele_add(xu4.telemetry, TZ_FRAME, now - fp->lastPresent);
+        tele_frameEnd(xu4.telemetry);
+    }
+    fp->lastPresent = now;
+
+    if (present > fp->frameUsec * 3 / 4) {
+        if (fp->swapBound < FP_SWAP_BOUND)
+            ++fp->swapBound;
+    } else
+        fp->swapBound = 0;
+    st->swapLimited = (fp->swapBound == FP_SWAP_BOUND);
 
-    if (waitTime && now >= waitTime)
+    // Headless runs go as fast as possible and measure waits with the step
+    // clock.
+    if (xu4.headless)
+        return waitUntil && fp->stepTime >= waitUntil;
+
+    if (waitUntil && now >= waitUntil)
         return 1;
-#if 0
-    printf("KR fsleep %d ela:%d avg:%d adj:%d\n",
-           fs->fsleep, elapsed, fs->ftimeSum / FS_SAMPLES, frameAdjust);
-#endif
-    if (fs->fsleep)
-        msecSleep(fs->fsleep);
+
+    fp->deadline += fp->frameUsec;
+    remain = fp->deadline - now;
+    if (remain <= 0 || st->swapLimited) {
+        if (remain < 0)
+            ++st->late;
+        // Resynchronize rather than try to make up for lost frames.
+        if (remain < -fp->frameUsec || st->swapLimited)
+            fp->deadline = now;
+        EMA(st->waitMsec, 0.0f);
+        return 0;
+    }
+
+    if (remain > fp->spinUsec) {
+        int64_t want = remain - fp->spinUsec;
+        int64_t over;
+
+        usecSleep(want);
+        over = usecTicks() - now - want;
+        if (over < 0)
+            over = 0;
+        EMA(st->overshootMsec, over * 0.001f);
+
+        // Keep the margin at twice the average overshoot.
+        fp->spinUsec = int32_t(st->overshootMsec * 2000.0f) + FP_SPIN_MIN;
+        if (fp->spinUsec > FP_SPIN_MAX)
+            fp->spinUsec = FP_SPIN_MAX;
+    }
+
+    while (usecTicks() < fp->deadline)
+        usecYield();
+
+    EMA(st->waitMsec, (usecTicks() - now) * 0.001f);
     return 0;
 }
 
@@ -224,30 +315,52 @@ static int frameSleep(FrameSleep* fs, uint32_t waitTime) {
 bool EventHandler::wait_msecs(unsigned int msec) {
     Controller waitCon;     // Base controller consumes key events.
     EventHandler* eh = xu4.eventHandler;
-    uint32_t waitTime = getTicks() + msec;
+    int64_t waitTime = (xu4.headless ? eh->fp.stepTime : usecTicks()) +
+                       int64_t(msec) * 1000;
 
     while (! eh->ended) {
+        {
+        TELE_SCOPE(TZ_INPUT);
         eh->handleInputEvents(&waitCon, NULL);
+        }
 #ifdef DEBUG
         int key;
         while ((key = eh->recordedKey()))
             waitCon.notifyKeyPressed(key);
         eh->recordTick();
 #endif
-        if (eh->runTime >= eh->timerInterval) {
-            eh->runTime -= eh->timerInterval;
-            eh->timedEvents.tick();
-        }
-        eh->runTime += eh->fs.frameInterval;
-
-        screenSwapBuffers();
-        if (frameSleep(&eh->fs, waitTime))
+        eh->tickTimers();
+        eh->runTime += eh->fp.frameInterval * TIMER_SUBTICKS;
+        notify_dispatch(&xu4.notifyBus);
+
+        if (frameStep(&eh->fp)) {
+            framePresent(&eh->fp);
+            if (framePace(&eh->fp, waitTime))
+                break;
+        } else if (usecTicks() >= waitTime)
             break;
     }
 
     return eh->ended;
 }
 
+/*
+ * Run the timer sub-ticks which are due.  At most one game cycle is run per
+ * step so short title screen intervals are limited to the frame rate.
+ */
+void EventHandler::tickTimers() {
+    TELE_SCOPE(TZ_TIMERS);
+    uint32_t subInterval = timerInterval ? timerInterval : 1;
+    int n;
+
+    // runTime is scaled by TIMER_SUBTICKS so timerInterval is the sub-tick
+    // length.
+    for (n = 0; n < TIMER_SUBTICKS && runTime >= subInterval; ++n) {
+        runTime -= subInterval;
+        timedEvents.tick();
+    }
+}
+
 /*
  * Execute the game with a deterministic loop until the current controller
  * is done or the game exits.
@@ -260,12 +373,15 @@ bool EventHandler::run() {
 
     if (! runRecursion) {
         runTime = 0;
-        fs.realTime = getTicks();
+        framePacerReset(&fp);
     }
     ++runRecursion;
 
     while (! ended && ! controllerDone) {
+        {
+        TELE_SCOPE(TZ_INPUT);
         handleInputEvents(NULL, updateScreen);
+        }
 #ifdef DEBUG
         int key;
         while ((key = recordedKey())) {
@@ -274,14 +390,14 @@ bool EventHandler::run() {
         }
         recordTick();
 #endif
-        if (runTime >= timerInterval) {
-            runTime -= timerInterval;
-            timedEvents.tick();
-        }
-        runTime += fs.frameInterval;
+        tickTimers();
+        runTime += fp.frameInterval * TIMER_SUBTICKS;
+        notify_dispatch(&xu4.notifyBus);
 
-        screenSwapBuffers();
-        frameSleep(&fs, 0);
+        if (frameStep(&fp)) {
+            framePresent(&fp);
+            framePace(&fp, 0);
+        }
     }
 
     --runRecursion;
@@ -411,6 +527,9 @@ int EventHandler::recordedKey() {
                 recordLast = recordClock + rec.delay;
             } else {
                 endRecording();
+                // A headless run has no other input so it is finished.
+                if (xu4.headless)
+                    quitGame();
             }
         }
     }
@@ -449,98 +568,182 @@ uint32_t EventHandler::replay(const char* file) {
 
 //----------------------------------------------------------------------------
 
-/* TimedEvent functions */
-TimedEvent::TimedEvent(TimedEvent::Callback cb, int i, void *d) :
-    callback(cb),
-    data(d),
-    interval(i),
-    current(0)
-{}
+/* TimedEventMgr functions */
 
-TimedEvent::Callback TimedEvent::getCallback() const    { return callback; }
-void *TimedEvent::getData()                             { return data; }
+// TimedEvent::list values other than a wheel slot.
+enum TimedEventList {
+    TEL_FREE   = -1,    // In the free list.
+    TEL_FIRING = -2,    // Callback is running; not in any list.
+    TEL_RUN    = -3     // In the run list of a tick() call.
+};
 
-/**
- * Advances the timed event forward a tick.
- * When (current >= interval), then it executes its callback function.
- */
-void TimedEvent::tick() {
-    if (++current >= interval) {
-        (*callback)(data);
-        current = 0;
-    }
+#define WHEEL_MASK  (TIMER_WHEEL_SIZE - 1)
+#define ID_INDEX(id)    ((id) & 0xffff)
+#define ID_SERIAL(id)   ((id) >> 16)
+
+TimedEventMgr::TimedEventMgr() : freeHead(-1), now(0) {
+    for (int i = 0; i < TIMER_WHEEL_SIZE; ++i)
+        wheel[i] = -1;
 }
 
-/**
- * Destructs a timed event manager object.
- */
-TimedEventMgr::~TimedEventMgr() {
-    while(! events.empty()) {
-        delete events.front(), events.pop_front();
-    }
-    while(! deferredRemovals.empty()) {
-        delete deferredRemovals.front(), deferredRemovals.pop_front();
+void TimedEventMgr::link(int index, int list) {
+    TimedEvent& ev = nodes[index];
+    int32_t* head = wheel + list;
+    ev.list = list;
+    ev.prev = -1;
+    ev.next = *head;
+    if (*head >= 0)
+        nodes[*head].prev = index;
+    *head = index;
+}
+
+void TimedEventMgr::unlink(int index) {
+    TimedEvent& ev = nodes[index];
+    if (ev.prev >= 0)
+        nodes[ev.prev].next = ev.next;
+    else
+        wheel[ev.list] = ev.next;
+    if (ev.next >= 0)
+        nodes[ev.next].prev = ev.prev;
+}
+
+void TimedEventMgr::release(int index) {
+    TimedEvent& ev = nodes[index];
+    ev.callback = NULL;
+    ev.list = TEL_FREE;
+    ev.next = freeHead;
+    ++ev.serial;
+    freeHead = index;
+}
+
+int TimedEventMgr::schedule(TimedEvent::Callback callback, uint32_t interval,
+                            void *data) {
+    int index;
+
+    if (freeHead >= 0) {
+        index = freeHead;
+        freeHead = nodes[index].next;
+    } else {
+        index = nodes.size();
+        assert(index <= 0xffff);
+        nodes.emplace_back();
+        nodes[index].serial = 0;
     }
+
+    TimedEvent& ev = nodes[index];
+    ev.callback = callback;
+    ev.data = data;
+    ev.interval = interval ? interval : 1;
+    ev.due = now + ev.interval;
+    link(index, ev.due & WHEEL_MASK);
+    return ev.serial << 16 | index;
 }
 
 /**
  * Adds a timed event to the event queue.
+ *
+ * \param interval  Number of game cycles between callbacks.
+ *
+ * \return Identifier which can be passed to remove().
  */
-void TimedEventMgr::add(TimedEvent::Callback callback, int interval, void *data) {
-    events.push_back(new TimedEvent(callback, interval, data));
+int TimedEventMgr::add(TimedEvent::Callback callback, int interval, void *data) {
+    return schedule(callback, interval * TIMER_SUBTICKS, data);
 }
 
 /**
- * Removes a timed event from the event queue.
+ * Adds a timed event which runs at an interval finer than the game cycle.
+ *
+ * \param subTicks  Number of timer sub-ticks (TIMER_SUBTICKS per cycle)
+ *                  between callbacks.
  */
-TimedEventMgr::List::iterator TimedEventMgr::remove(List::iterator i) {
-    if (isLocked()) {
-        deferredRemovals.push_back(*i);
-        return i;
-    }
-    else {
-        delete *i;
-        return events.erase(i);
-    }
+int TimedEventMgr::addSubCycle(TimedEvent::Callback callback, int subTicks,
+                               void *data) {
+    return schedule(callback, subTicks, data);
 }
 
-void TimedEventMgr::remove(TimedEvent* event) {
-    List::iterator i;
-    for (i = events.begin(); i != events.end(); i++) {
-        if ((*i) == event) {
-            remove(i);
-            break;
-        }
+/**
+ * Removes a timed event from the event queue.  This is safe to call from
+ * within a callback, including for the event currently running.
+ */
+void TimedEventMgr::remove(int id) {
+    int index = ID_INDEX(id);
+    if (index >= (int) nodes.size())
+        return;
+
+    TimedEvent& ev = nodes[index];
+    if (ev.list == TEL_FREE || ev.serial != ID_SERIAL(id))
+        return;
+    if (ev.list == TEL_FIRING || ev.list == TEL_RUN)
+        ev.callback = NULL;     // Released by tick().
+    else {
+        unlink(index);
+        release(index);
     }
 }
 
+/**
+ * Removes the first timed event with the given callback & data.
+ */
 void TimedEventMgr::remove(TimedEvent::Callback callback, void *data) {
-    List::iterator i;
-    for (i = events.begin(); i != events.end(); i++) {
-        if ((*i)->getCallback() == callback && (*i)->getData() == data) {
-            remove(i);
+    int i, count = nodes.size();
+    for (i = 0; i < count; ++i) {
+        const TimedEvent& ev = nodes[i];
+        if (ev.list != TEL_FREE && ev.callback == callback &&
+            ev.data == data) {
+            remove(ev.serial << 16 | i);
             break;
         }
     }
 }
 
 /**
- * Runs each of the callback functions of the TimedEvents associated with this manager.
+ * Advances the timer by one sub-tick and runs the callbacks of any events
+ * which are due.
+ *
+ * This may be called again from inside a callback (e.g. when it waits for
+ * a screen effect).  Each call keeps its own run list, so the nested call
+ * only runs the events of the following sub-tick and the rest of the outer
+ * list runs after it returns.
  */
 void TimedEventMgr::tick() {
-    List::iterator i;
-
-    // Lock the event list so it cannot be modified during iteration.
-    locked = true;
-
-    for (i = events.begin(); i != events.end(); i++)
-        (*i)->tick();
+    int32_t runHead;
+    int index, slot;
+    uint32_t tickTime;
+
+    tickTime = ++now;
+    slot = tickTime & WHEEL_MASK;
+
+    // Detach the slot so that callbacks adding events with an interval of
+    // the wheel size do not run again this tick.
+    runHead = wheel[slot];
+    wheel[slot] = -1;
+    for (index = runHead; index >= 0; index = nodes[index].next)
+        nodes[index].list = TEL_RUN;
+
+    while ((index = runHead) >= 0) {
+        TimedEvent* ev = &nodes[index];
+        runHead = ev->next;
+
+        if (! ev->callback) {
+            release(index);     // Removed while in the run list.
+            continue;
+        }
+        if (ev->due != tickTime) {
+            // Not due until a later turn of the wheel.
+            link(index, ev->due & WHEEL_MASK);
+            continue;
+        }
 
-    locked = false;
+        ev->list = TEL_FIRING;
+        ev->callback(ev->data);
 
-    // Remove events that have been deferred for removal
-    for (i = deferredRemovals.begin(); i != deferredRemovals.end(); i++)
-        events.remove(*i);
+        ev = &nodes[index];     // Pool may have grown.
+        if (ev->callback) {
+            ev->due = now + ev->interval;
+            link(index, ev->due & WHEEL_MASK);
+        } else
+            release(index);
+    }
 }
 
 void EventHandler::pushMouseAreaSet(const MouseArea *mouseAreas) {
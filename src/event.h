@@ -58,27 +58,21 @@ struct InputEvent {
 //----------------------------------------------------------------------------
 
 /**
- * A class for handling timed events.
+ * A timed event node.  These are owned by a TimedEventMgr.
  */
 class TimedEvent {
 public:
     /* Typedefs */
     typedef void (*Callback)(void *);
 
-    /* Constructors */
-    TimedEvent(Callback callback, int interval, void *data = NULL);
-
-    /* Member functions */
-    Callback getCallback() const;
-    void *getData();
-    void tick();
-
-    /* Properties */
-protected:
     Callback callback;
     void *data;
-    int interval;
-    int current;
+    uint32_t due;           // Sub-tick when the callback next runs.
+    uint32_t interval;      // Sub-ticks between runs.
+    int32_t next;           // Node links (index or -1).
+    int32_t prev;
+    int16_t list;           // Wheel slot or one of the TEL_* values.
+    uint16_t serial;        // Incremented on reuse to invalidate old ids.
 };
 
 #if defined(IOS)
@@ -91,42 +85,67 @@ typedef void *UIEvent;
 #endif
 #endif
 
+#define TIMER_SUBTICKS      4       // Timer sub-ticks per game cycle.
+#define TIMER_WHEEL_SIZE    64      // Must be a power of two.
 
 /**
- * A class for managing timed events
+ * A class for managing timed events.
+ *
+ * Events are kept in a hashed timing wheel so each tick only visits the
+ * events which are due (plus any with an interval longer than the wheel
+ * that happen to share its slot).  Nodes are pooled and linked by index,
+ * so adding and removing an event is O(1) and does no allocation once the
+ * pool has grown to the peak number of events.
  */
 class TimedEventMgr {
 public:
-    typedef std::list<TimedEvent*> List;
-
-    TimedEventMgr() : locked(false) {}
-    ~TimedEventMgr();
-
-    /** Returns true if the event list is locked (in use) */
-    bool isLocked() const { return locked; }
+    TimedEventMgr();
 
-    void add(TimedEvent::Callback callback, int interval, void *data = NULL);
-    List::iterator remove(List::iterator i);
-    void remove(TimedEvent* event);
+    int  add(TimedEvent::Callback callback, int interval, void *data = NULL);
+    int  addSubCycle(TimedEvent::Callback callback, int subTicks,
+                     void *data = NULL);
+    void remove(int id);
     void remove(TimedEvent::Callback callback, void *data = NULL);
     void tick();
 
 private:
+    int  schedule(TimedEvent::Callback, uint32_t interval, void *data);
+    void link(int index, int list);
+    void unlink(int index);
+    void release(int index);
+
     /* Properties */
-    bool locked;
-    List events;
-    List deferredRemovals;
+    std::vector<TimedEvent> nodes;
+    int32_t freeHead;
+    uint32_t now;
+    int32_t wheel[TIMER_WHEEL_SIZE];
 };
 
-#define FS_SAMPLES  8
+#define FP_MAX_SKIP 4
+
+// Frame timing statistics.  The times are moving averages in milliseconds.
+struct FrameStats {
+    float frameMsec;            // Time between presented frames.
+    float presentMsec;          // Time spent rendering & swapping buffers.
+    float waitMsec;             // Time spent waiting for the frame deadline.
+    float overshootMsec;        // Time slept past the requested wake up.
+    uint32_t frames;            // Number of frames presented.
+    uint32_t late;              // Frames which missed their deadline.
+    uint32_t skipped;           // Game steps which were not rendered.
+    bool swapLimited;           // Frame rate is paced by the buffer swap.
+};
 
-struct FrameSleep {
+struct FramePacer {
     uint32_t frameInterval;     // Milliseconds between display updates.
-    uint32_t realTime;
-    int ftime[FS_SAMPLES];      // Msec elapsed for past frames.
-    int ftimeSum;
-    uint16_t ftimeIndex;
-    uint16_t fsleep;            // Msec to sleep - adjusted slowly.
+    int64_t frameUsec;          // Frame period in microseconds.
+    int64_t deadline;           // Time at which the next frame is due.
+    int64_t stepTime;           // Time at which the current step is due.
+    int64_t frameStart;         // Time when the last present began.
+    int64_t lastPresent;        // Time when the last present completed.
+    int32_t spinUsec;           // Busy-wait margin before the deadline.
+    uint16_t swapBound;         // Consecutive frames limited by the swap.
+    uint16_t skipped;           // Frames not rendered since the last frame.
+    FrameStats stats;
 };
 
 typedef void(*updateScreenCallback)(void);
@@ -202,6 +221,8 @@ public:
     uint32_t replay(const char* file);
 #endif
 
+    const FrameStats* frameStats() const { return &fp.stats; }
+
     void advanceFlourishAnim() {
         anim_advance(&flourishAnim, float(timerInterval) * 0.001f);
     }
@@ -211,10 +232,11 @@ public:
 
 protected:
     void handleInputEvents(Controller*, updateScreenCallback);
+    void tickTimers();
 
-    FrameSleep fs;
+    FramePacer fp;
     uint32_t timerInterval;     // Milliseconds between timedEvents ticks.
-    uint32_t runTime;
+    uint32_t runTime;           // Milliseconds * TIMER_SUBTICKS.
     int runRecursion;
 #ifdef DEBUG
     int recordFP;
@@ -3,6 +3,7 @@
  */
 
 #include "game.h"
+#include "autosave.h"
 
 #include "camp.h"
 #include "cheat.h"
@@ -23,6 +24,7 @@
 #include "portal.h"
 #include "progress_bar.h"
 #include "savegame.h"
+#include "savewriter.h"
 #include "screen.h"
 #include "settings.h"
 #include "spell.h"
@@ -134,7 +136,8 @@ void GameController::initScreenWithoutReloadingState()
 
     borderAttr = xu4.config->newDrawList(BKGD_BORDERS, &borderAttrLen);
     if (borderAttr) {
-        float* attr = gpu_beginTris(xu4.gpu, GPU_DLIST_HUD);
+        float* attr = gpu_beginTris(xu4.gpu, GPU_DLIST_HUD,
+                                    borderAttrLen / GPU_QUAD_ATTR_LEN);
         if (attr) {
             memcpy(attr, borderAttr, borderAttrLen * sizeof(float));
             gpu_endTris(xu4.gpu, GPU_DLIST_HUD, attr + borderAttrLen);
@@ -256,7 +259,9 @@ bool GameController::initContext() {
     /* load in monsters.sav */
     {
     MonstersSav mons;
-    FILE* fp = fopen((settings.getUserPath() + MONSTERS_SAV).c_str(), "rb");
+    FILE* fp;
+    savewriter_wait();
+    fp = fopen((settings.getUserPath() + MONSTERS_SAV).c_str(), "rb");
     if (fp) {
         saveGameMonstersRead(mons.table, fp);
         fclose(fp);
@@ -290,28 +295,15 @@ bool GameController::initContext() {
 }
 
 /**
- * Saves the game state into party.sav and monsters.sav.
- * For dungeons dngmap.sav & outmonst.sav are also created.
+ * Pack the game state into a job holding party.sav and monsters.sav.
+ * For dungeons dngmap.sav & outmonst.sav are also added.
  */
-int gameSave(const char* userPath) {
-    FILE *fp;
-    string sbuf(userPath);
-    size_t userPathLen = sbuf.size();
-    const char* basename;
+SaveJob* gamePackSave(const char* userPath, int syncMode) {
     const Location* loc = c->location;
     const Map* map = loc->map;
     SaveGame save = *c->saveGame;
     MonstersSav mons;
-
-#define openSaveFile(FN) \
-    basename = FN; \
-    sbuf.erase(userPathLen, string::npos); \
-    sbuf.append(basename); \
-    fp = fopen(sbuf.c_str(), "wb"); \
-    if (!fp) { \
-        screenMessage("Error opening %s\n", basename); \
-        return 0; \
-    }
+    SaveJob* job;
 
     /*************************************************/
     /* Make sure the savegame struct is accurate now */
@@ -335,46 +327,41 @@ int gameSave(const char* userPath) {
     /* Done making sure the savegame struct is accurate */
     /****************************************************/
 
+    job = savewriter_newJob(userPath, syncMode);
 
-    openSaveFile(PARTY_SAV);
-    if (! save.write(fp))
-        goto write_error;
-    fclose(fp);
-
+    save.pack(savewriter_addFile(job, PARTY_SAV, SAVEGAME_PACKED_SIZE));
 
-    openSaveFile(MONSTERS_SAV);
     if (map->type == Map::DUNGEON)
         map->fillMonsterTableDungeon(mons.table);
     else
         map->fillMonsterTable(mons.table);
-    if (! saveGameMonstersWrite(mons.table, fp))
-        goto write_error;
-    fclose(fp);
-
+    saveGameMonstersPack(mons.table,
+            savewriter_addFile(job, MONSTERS_SAV, MONSTERS_PACKED_SIZE));
 
     /**
      * Write dngmap.sav & outmonst.sav
      */
     if (loc->context & CTX_DUNGEON) {
-        openSaveFile(DNGMAP_SAV);
         const uint8_t* data = static_cast<Dungeon*>((Map*) map)->fillRawMap();
         size_t dataLen = map->width * map->height * map->levels;
-        fwrite(data, 1, dataLen, fp);
-        fclose(fp);
+        memcpy(savewriter_addFile(job, DNGMAP_SAV, dataLen), data, dataLen);
 
-
-        openSaveFile(OUTMONST_SAV);
         loc->prev->map->fillMonsterTable(mons.table);
-        if (! saveGameMonstersWrite(mons.table, fp))
-            goto write_error;
-        fclose(fp);
+        saveGameMonstersPack(mons.table,
+                savewriter_addFile(job, OUTMONST_SAV, MONSTERS_PACKED_SIZE));
     }
-    return 1;
+    return job;
+}
 
-write_error:
-    fclose(fp);
-    screenMessage("Error writing to %s\n", basename);
-    return 0;
+/**
+ * Saves the game state into party.sav and monsters.sav.
+ * For dungeons dngmap.sav & outmonst.sav are also created.
+ *
+ * The files are written by the savewriter thread and this returns without
+ * waiting for them.  GameController::finishTurn() reports any failure.
+ */
+void gameSave(const char* userPath) {
+    savewriter_submit(gamePackSave(userPath, xu4.settings->saveSync));
 }
 
 /**
@@ -474,6 +461,7 @@ void GameController::setMap(Map *map, bool saveLocation, const Portal *portal, T
     }
 
     gameStampCommandTime();     // Restart turn Pass timer.
+    autosave_mapChanged();
 }
 
 /**
@@ -506,6 +494,7 @@ int GameController::exitToParentMap() {
         U4IOS::updateGameControllerContext(c->location->context);
 #endif
         gameStampCommandTime();     // Restart turn Pass timer.
+        autosave_mapChanged();
         return 1;
     }
     return 0;
@@ -615,6 +604,12 @@ void GameController::finishTurn() {
         }
     }
 
+    autosave_update();
+    screenCaptureTurn(c->saveGame->moves);
+
+    // Saves are written in the background; report any that failed.
+    if (savewriter_failures())
+        screenMessage("%cSave failed!%c\n", FG_RED, FG_WHITE);
 
     /* draw a prompt */
     screenPrompt();
@@ -671,7 +666,7 @@ void GameController::gameNotice(int sender, void* eventData, void* user) {
             break;
         }
     }
-    else if (sender == SENDER_PARTY)
+    else if (sender == SENDER_PARTY && eventData)
     {
         // Provide feedback to user after a party event happens.
         PartyEvent* ev = (PartyEvent*) eventData;
@@ -3267,7 +3262,7 @@ void gameSetActivePlayer(int player) {
  * Removes creatures from the current map if they are too far away from the avatar
  */
 void GameController::creatureCleanup() {
-    ObjectDeque::iterator i;
+    ObjectVector::iterator i;
     Map *map = c->location->map;
 
     for (i = map->objects.begin(); i != map->objects.end();) {
@@ -3436,7 +3431,7 @@ void gameDestroyAllCreatures() {
     }
     else {
         /* destroy all creatures on the map */
-        ObjectDeque::iterator current;
+        ObjectVector::iterator current;
         Map *map = c->location->map;
 
         for (current = map->objects.begin(); current != map->objects.end();) {
@@ -3460,7 +3455,7 @@ void gameDestroyAllCreatures() {
  * Creates the balloon near Hythloth, but only if the balloon doesn't already exists somewhere
  */
 bool GameController::createBalloon(Map *map) {
-    ObjectDeque::iterator i;
+    ObjectVector::iterator i;
 
     /* see if the balloon has already been created (and not destroyed) */
     for (i = map->objects.begin(); i != map->objects.end(); i++) {
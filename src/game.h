@@ -17,6 +17,7 @@
 
 using std::vector;
 
+struct SaveJob;
 struct Portal;
 class Creature;
 class MoveEvent;
@@ -106,6 +107,10 @@ private:
     int borderAttrLen;
 };
 
+/* save functions */
+SaveJob* gamePackSave(const char* userPath, int syncMode);
+void gameSave(const char* userPath);
+
 /* map and screen functions */
 void gameSetViewMode(ViewMode newMode);
 void gameUpdateScreen();
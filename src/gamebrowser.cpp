@@ -49,6 +49,7 @@ GameBrowser::GameBrowser()
     sel = selMusic = 0;
     psizeList = 20.0f;
     atree = NULL;
+    gui_cacheInit(&guiCache);
 }
 
 #define NO_PARENT   255
@@ -250,7 +251,8 @@ void GameBrowser::layout()
 
     TxfDrawState ds;
     ds.fontTable = screenState()->fontTable;
-    float* attr = gui_layout(GPU_DLIST_GUI, NULL, &ds, browserGui, guiData);
+    float* attr = gui_layoutCached(&guiCache, GPU_DLIST_GUI, 1, NULL, &ds,
+                                   browserGui, guiData);
     if (attr) {
         if (selMusic) {
             // Draw green checkmark.
@@ -266,7 +268,7 @@ void GameBrowser::layout()
 
             int quads = txf_genText(&ds, attr + 3, attr, ATTR_COUNT,
                                     (const uint8_t*) "c", 1);
-            attr += quads * 6 * ATTR_COUNT;
+            attr += quads * 4 * ATTR_COUNT;
         }
 
         gpu_endTris(xu4.gpu, GPU_DLIST_GUI, attr);
@@ -301,6 +303,7 @@ bool GameBrowser::present()
     }
     }
 
+    gui_cacheInvalidate(&guiCache);
     layout();
     screenSetLayer(LAYER_TOP_MENU, renderBrowser, this);
     return true;
@@ -310,6 +313,7 @@ void GameBrowser::conclude()
 {
     free(atree);
     atree = NULL;
+    gui_cacheFree(&guiCache);
 
     screenSetLayer(LAYER_TOP_MENU, NULL, NULL);
     sst_free(&modFiles);
@@ -37,6 +37,7 @@ private:
     uint16_t sel;
     uint16_t selMusic;          // 0 = none
     GuiArea gbox[ WI_COUNT ];
+    GuiCache guiCache;          // Widgets without the music checkmark.
     void* atree;
     float lineHeight;
     float psizeList;            // List font point size.
@@ -3,19 +3,30 @@
 enum GpuDrawList {
     GPU_DLIST_GUI,
     GPU_DLIST_HUD,
+    GPU_DLIST_OVERLAY,
     GPU_DLIST_VIEW_OBJ,
     GPU_DLIST_VIEW_FX
 };
 
+// Number of floats in each vertex of a draw list.
+#define GPU_VERT_ATTR_LEN   7
+
+// Number of floats emitted for each quad by gpu_emitQuad().
+#define GPU_QUAD_ATTR_LEN   (GPU_VERT_ATTR_LEN * 4)
+
 struct BlockingGroups;
+struct VisibleSprite;
 class Map;
 class TileView;
 
 const char* gpu_init(void* res, int w, int h, int scale, int filter);
 void     gpu_free(void* res);
 void     gpu_viewport(int x, int y, int w, int h);
+void     gpu_readPixels(int x, int y, Image32* img);
 uint32_t gpu_makeTexture(const Image32* img);
 void     gpu_blitTexture(uint32_t tex, int x, int y, const Image32* img);
+void     gpu_blitTextureRect(uint32_t tex, const Image32* img,
+                             int x, int y, int w, int h);
 void     gpu_freeTexture(uint32_t id);
 uint32_t gpu_screenTexture(void* res);
 void     gpu_setTilesTexture(void* res, uint32_t tex, uint32_t mat, float vDim);
@@ -23,14 +34,19 @@ void     gpu_drawTextureScaled(void* res, uint32_t tex);
 void     gpu_clear(void* res, const float* color);
 void     gpu_invertColors(void* res);
 void     gpu_setScissor(int* box);
-float*   gpu_beginTris(void* res, int list);
+float*   gpu_beginTris(void* res, int list, int quadCount);
 void     gpu_endTris(void* res, int list, float* attr);
 void     gpu_clearTris(void* res, int list);
 void     gpu_drawTris(void* res, int list);
+void     gpu_drawTrisImage(void* res, int list, uint32_t tex);
 void     gpu_drawGui(void* res, int list);
 void     gpu_guiClutUV(void* res, float* uv, float colorIndex);
 float*   gpu_emitQuad(float* attr, const float* drawRect, const float* uvRect);
+float*   gpu_emitSprites(float* attr, const VisibleSprite* sprites, int count,
+                         const float* tileUVs, int cx, int cy);
 void     gpu_resetMap(void* res, const Map* map);
+void     gpu_resetMapData(void* res, const Map* map, const uint16_t* data,
+                          int width, int height, int chunkDim);
 void     gpu_drawMap(void* res, const TileView* view, const float* tileUVs,
                      const BlockingGroups* blocks,
                      int cx, int cy, float scale);
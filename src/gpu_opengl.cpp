@@ -88,6 +88,7 @@ const char* cmap_fragShader =
 
 #define ATTR_COUNT      7
 #define ATTR_STRIDE     (sizeof(float) * ATTR_COUNT)
+#define QUAD_ATTR_LEN   (ATTR_COUNT * 4)
 static const float quadAttr[] = {
     // X   Y   Z       U  V  vunit  scrollSourceV
    -1.0,-1.0, 0.0,   0.0, 1.0, 0.0, 0.0,
@@ -284,9 +285,10 @@ static int compileSLFile(GLuint program, const char* filename, int scale)
     return res;
 }
 
-static void _defineAttributeLayout(GLuint vao, GLuint vbo)
+static void _defineAttributeLayout(GLuint vao, GLuint vbo, GLuint ibo)
 {
     glBindVertexArray(vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     glEnableVertexAttribArray(LOC_POS);
     glVertexAttribPointer(LOC_POS, 3, GL_FLOAT, GL_FALSE, ATTR_STRIDE, 0);
@@ -389,6 +391,46 @@ static void reserveDrawList(const GLuint* vbo, int byteSize)
     }
 }
 
+/*
+ * Ensure the quad element buffer has indices for at least quadCount quads.
+ * Each quad is four vertices (lower-left, lower-right, top-right, top-left)
+ * drawn as two triangles.
+ */
+static void reserveQuadIndices(OpenGLResources* gr, int quadCount)
+{
+    GLuint* indices;
+    GLuint* ip;
+    GLuint v;
+    int limit;
+
+    if (quadCount <= gr->quadIndexLimit)
+        return;
+
+    limit = gr->quadIndexLimit ? gr->quadIndexLimit : 512;
+    while (limit < quadCount)
+        limit *= 2;
+
+    ip = indices = (GLuint*) malloc(limit * 6 * sizeof(GLuint));
+    for (v = 0; v < (GLuint) limit * 4; v += 4) {
+        *ip++ = v;
+        *ip++ = v + 1;
+        *ip++ = v + 2;
+        *ip++ = v + 2;
+        *ip++ = v + 3;
+        *ip++ = v;
+    }
+
+    // The element buffer binding is part of the VAO state so unbind any
+    // current VAO before touching it.
+    glBindVertexArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gr->quadIndexBuf);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, limit * 6 * sizeof(GLuint),
+                 indices, GL_STATIC_DRAW);
+    free(indices);
+
+    gr->quadIndexLimit = limit;
+}
+
 const char* gpu_init(void* res, int w, int h, int scale, int filter)
 {
     OpenGLResources* gr = (OpenGLResources*) res;
@@ -409,17 +451,20 @@ const char* gpu_init(void* res, int w, int h, int scale, int filter)
     gr->tilesTex = 0;
     */
 
+    // Initial draw list sizes.  These grow as needed in gpu_beginTris().
     gr->dl[0].buf = GLOB_GUI_LIST0;
-    gr->dl[0].byteSize = ATTR_STRIDE * 6 * 400;
+    gr->dl[0].byteSize = ATTR_STRIDE * 4 * 400;
     gr->dl[1].buf = GLOB_HUD_LIST0;
-    gr->dl[1].byteSize = ATTR_STRIDE * 6 * 400;
+    gr->dl[1].byteSize = ATTR_STRIDE * 4 * 400;
+    gr->dl[2].buf = GLOB_OVERLAY_LIST0;
+    gr->dl[2].byteSize = ATTR_STRIDE * 4 * 200;
 #ifdef GPU_RENDER
-    gr->dl[2].buf = GLOB_DRAW_LIST0;
-    gr->dl[2].byteSize = ATTR_STRIDE * 6 * 400;
-    gr->dl[3].buf = GLOB_FX_LIST0;
-    gr->dl[3].byteSize = ATTR_STRIDE * 6 * 20;
-    gr->dl[4].buf = GLOB_MAPFX_LIST0;
-    gr->dl[4].byteSize = ATTR_STRIDE * 6 * 8;
+    gr->dl[3].buf = GLOB_DRAW_LIST0;
+    gr->dl[3].byteSize = ATTR_STRIDE * 4 * 400;
+    gr->dl[4].buf = GLOB_FX_LIST0;
+    gr->dl[4].byteSize = ATTR_STRIDE * 4 * 20;
+    gr->dl[5].buf = GLOB_MAPFX_LIST0;
+    gr->dl[5].byteSize = ATTR_STRIDE * 4 * 4*CHUNK_FX_LIMIT;
 #endif
 
 #ifdef DEBUG_GL
@@ -595,14 +640,17 @@ const char* gpu_init(void* res, int w, int h, int scale, int filter)
 
     // Create our vertex buffers.
     glGenBuffers(GLOB_COUNT, gr->vbo);
+    glGenBuffers(1, &gr->quadIndexBuf);
+    reserveQuadIndices(gr, 400);
 
     // Reserve space in the double-buffered draw lists.
     reserveDrawList(gr->vbo + GLOB_GUI_LIST0, gr->dl[0].byteSize);
     reserveDrawList(gr->vbo + GLOB_HUD_LIST0, gr->dl[1].byteSize);
+    reserveDrawList(gr->vbo + GLOB_OVERLAY_LIST0, gr->dl[2].byteSize);
 #ifdef GPU_RENDER
-    reserveDrawList(gr->vbo + GLOB_DRAW_LIST0, gr->dl[2].byteSize);
-    reserveDrawList(gr->vbo + GLOB_FX_LIST0,   gr->dl[3].byteSize);
-    reserveDrawList(gr->vbo + GLOB_MAPFX_LIST0,gr->dl[4].byteSize);
+    reserveDrawList(gr->vbo + GLOB_DRAW_LIST0, gr->dl[3].byteSize);
+    reserveDrawList(gr->vbo + GLOB_FX_LIST0,   gr->dl[4].byteSize);
+    reserveDrawList(gr->vbo + GLOB_MAPFX_LIST0,gr->dl[5].byteSize);
 #endif
 
     // Create quad geometry.
@@ -612,7 +660,7 @@ const char* gpu_init(void* res, int w, int h, int scale, int filter)
     // Create vertex attribute layouts.
     glGenVertexArrays(GLOB_COUNT, gr->vao);
     for(int i = 0; i < GLOB_COUNT; ++i)
-        _defineAttributeLayout(gr->vao[i], gr->vbo[i]);
+        _defineAttributeLayout(gr->vao[i], gr->vbo[i], gr->quadIndexBuf);
     glBindVertexArray(0);
 
     return NULL;
@@ -629,6 +677,7 @@ void gpu_free(void* res)
 
     glDeleteVertexArrays(GLOB_COUNT, gr->vao);
     glDeleteBuffers(GLOB_COUNT, gr->vbo);
+    glDeleteBuffers(1, &gr->quadIndexBuf);
     glDeleteProgram(gr->shadeColor);
     glDeleteProgram(gr->shadeSolid);
     glDeleteProgram(gr->shadeGlyph);
@@ -645,6 +694,35 @@ void gpu_viewport(int x, int y, int w, int h)
     glViewport(x, y, w, h);
 }
 
+/*
+ * Read an area of the framebuffer into an image of the same size.
+ * The alpha channel is set to opaque.
+ */
+void gpu_readPixels(int x, int y, Image32* img)
+{
+    uint32_t* top = img->pixels;
+    uint32_t* bot = top + img->w * (img->h - 1);
+    uint32_t* end;
+    uint32_t tmp;
+    int n;
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(x, y, img->w, img->h, GL_RGBA, GL_UNSIGNED_BYTE, top);
+
+    // OpenGL rows go from bottom to top.
+    for (; top < bot; bot -= 2 * img->w) {
+        for (end = top + img->w; top != end; ++top, ++bot) {
+            tmp = *top;
+            *top = *bot;
+            *bot = tmp;
+        }
+    }
+
+    n = img->w * img->h;
+    for (top = img->pixels; n--; ++top)
+        ((RGBA*) top)->a = 255;
+}
+
 #if 0
 /*
  * Load a texture from a module file.
@@ -674,6 +752,19 @@ void gpu_blitTexture(uint32_t tex, int x, int y, const Image32* img)
                     GL_RGBA, GL_UNSIGNED_BYTE, img->pixels);
 }
 
+/*
+ * Copy a rectangular area of an image to the same position in a texture.
+ */
+void gpu_blitTextureRect(uint32_t tex, const Image32* img,
+                         int x, int y, int w, int h)
+{
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, img->w);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h,
+                    GL_RGBA, GL_UNSIGNED_BYTE, img->pixels + img->w * y + x);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
 /*
  * Release texture created with gpu_makeTexture() or gpu_loadTexture().
  */
@@ -759,23 +850,38 @@ void gpu_setScissor(int* box)
 }
 
 /*
- * Begin adding triangles to a double-buffered draw list.
+ * Begin adding quads to a double-buffered draw list.
  *
  * Returns a pointer to the start of the attributes buffer.
- * This should be advanced and passed to gpu_endTris() when all triangles
+ * This should be advanced and passed to gpu_endTris() when all quads
  * have been generated.
  *
- * /param list  The list identifier in the range 0-2.
+ * The buffers are enlarged if needed to hold quadCount quads.
+ *
+ * /param list       The list identifier in the range 0-5.
+ * /param quadCount  Maximum number of quads which will be emitted.
  */
-float* gpu_beginTris(void* res, int list)
+float* gpu_beginTris(void* res, int list, int quadCount)
 {
     OpenGLResources* gr = (OpenGLResources*) res;
     DrawList* dl = gr->dl + list;
+    int byteSize;
+
+    if (quadCount < 1)
+        quadCount = 1;
+    byteSize = quadCount * QUAD_ATTR_LEN * sizeof(float);
+    if (byteSize > dl->byteSize) {
+        // Both buffers must hold the list so they are enlarged together.
+        dl->byteSize = byteSize + byteSize / 2;
+        reserveDrawList(gr->vbo + (dl->buf & ~1), dl->byteSize);
+        reserveQuadIndices(gr, dl->byteSize / (QUAD_ATTR_LEN * sizeof(float)));
+    }
+    dl->limit = quadCount * QUAD_ATTR_LEN;
 
     dl->buf ^= 1;
     glBindBuffer(GL_ARRAY_BUFFER, gr->vbo[ dl->buf ]);
-    gr->dptr = (GLfloat*) glMapBufferRange(GL_ARRAY_BUFFER, 0, dl->byteSize,
-                                           GL_MAP_WRITE_BIT);
+    gr->dptr = (GLfloat*) glMapBufferRange(GL_ARRAY_BUFFER, 0, byteSize,
+                                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
     return gr->dptr;
 }
 
@@ -787,11 +893,19 @@ float* gpu_beginTris(void* res, int list)
 void gpu_endTris(void* res, int list, float* attr)
 {
     OpenGLResources* gr = (OpenGLResources*) res;
+    DrawList* dl = gr->dl + list;
 
     glUnmapBuffer(GL_ARRAY_BUFFER);
 
     assert(gr->dptr);
-    gr->dl[ list ].count = attr - gr->dptr;
+    dl->count = attr - gr->dptr;
+    if (dl->count > dl->limit) {
+        // The caller wrote more quads than it reserved.  Only draw what was
+        // mapped so the GPU never reads past the end of the list.
+        fprintf(stderr, "gpu_endTris: list %d overflow (%d > %d floats)\n",
+                list, (int) dl->count, (int) dl->limit);
+        dl->count = dl->limit;
+    }
     gr->dptr = NULL;
 }
 
@@ -806,7 +920,7 @@ void gpu_clearTris(void* res, int list)
 }
 
 /*
- * Draw any triangles created between the last gpu_beginTris/endTris calls.
+ * Draw any quads created between the last gpu_beginTris/endTris calls.
  */
 void gpu_drawTris(void* res, int list)
 {
@@ -822,8 +936,31 @@ void gpu_drawTris(void* res, int list)
     glBlendEquation(GL_FUNC_ADD);
 
     glBindVertexArray(gr->vao[ dl->buf ]);
-    glDrawArrays(GL_TRIANGLES, 0, dl->count / ATTR_COUNT);
+    glDrawElements(GL_TRIANGLES, dl->count / QUAD_ATTR_LEN * 6,
+                   GL_UNSIGNED_INT, 0);
+}
+
+#ifdef GPU_RENDER
+/*
+ * Draw a list of quads textured from a single image.  The quad positions
+ * are in U4 screen pixels with the origin at the lower left of the current
+ * viewport.
+ */
+void gpu_drawTrisImage(void* res, int list, uint32_t tex)
+{
+    OpenGLResources* gr = (OpenGLResources*) res;
+    float ortho[16];
+
+    m4_ortho(ortho, 0.0f, (float) U4_SCREEN_W, 0.0f, (float) U4_SCREEN_H,
+             -1.0f, 1.0f);
+    glUseProgram(gr->shadeColor);
+    glUniformMatrix4fv(gr->slocTrans, 1, GL_FALSE, ortho);
+    glActiveTexture(GL_TEXTURE0 + GTU_CMAP);
+    glBindTexture(GL_TEXTURE_2D, tex);
+
+    gpu_drawTris(gr, list);
 }
+#endif
 
 void gpu_drawGui(void* res, int list)
 {
@@ -851,19 +988,22 @@ void gpu_guiClutUV(void* res, float* uv, float colorIndex)
     uv[1] = 0.5f / gr->guiTexSize[1];
 }
 
+/*
+ * Emit the four vertices of a quad.  These are drawn as two triangles using
+ * the indices created by reserveQuadIndices().
+ *
+ * Return pointer to the end of the quad attributes.
+ */
 float* gpu_emitQuad(float* attr, const float* drawRect, const float* uvRect)
 {
     float w = drawRect[2];
     float h = drawRect[3];
-    int i;
 
     /*
    -1.0,-1.0, 0.0,   0.0, 1.0,
     1.0,-1.0, 0.0,   1.0, 1.0,
     1.0, 1.0, 0.0,   1.0, 0.0,
-    1.0, 1.0, 0.0,   1.0, 0.0,
-   -1.0, 1.0, 0.0,   0.0, 0.0,
-   -1.0,-1.0, 0.0,   0.0, 1.0
+   -1.0, 1.0, 0.0,   0.0, 0.0
     */
 
 #if 0
@@ -894,29 +1034,55 @@ float* gpu_emitQuad(float* attr, const float* drawRect, const float* uvRect)
     EMIT_UV(uvRect[2], uvRect[3]);
 
     // Top-right corner
-    for (i = 0; i < 2; ++i) {
-        EMIT_POS(drawRect[0] + w, drawRect[1] + h);
-        EMIT_UV(uvRect[2], uvRect[1]);
-    }
+    EMIT_POS(drawRect[0] + w, drawRect[1] + h);
+    EMIT_UV(uvRect[2], uvRect[1]);
 
     // Top-left corner
     EMIT_POS(drawRect[0], drawRect[1] + h);
     EMIT_UV(uvRect[0], uvRect[1]);
 
-    // Repeat first vertex
-    EMIT_POS(drawRect[0], drawRect[1]);
-    EMIT_UV(uvRect[0], uvRect[3]);
-
     return attr;
 }
 
 #ifdef GPU_RENDER
+/*
+ * Emit a one unit quad for each sprite with the view center (cx, cy) as
+ * the origin.  The vertex attributes are the same as gpu_emitQuad().
+ *
+ * Return pointer to the end of the quad attributes.
+ */
+float* gpu_emitSprites(float* attr, const VisibleSprite* it, int count,
+                       const float* tileUVs, int cx, int cy)
+{
+    const VisibleSprite* end = it + count;
+    const float* uv;
+    float x, y;
+
+    for (; it != end; ++it) {
+        uv = tileUVs + VID_INDEX(it->vid) * 4;
+        x = (float) (it->x - cx) - 0.5f;
+        y = (float) (cy - it->y) - 0.5f;
+
+        EMIT_POS(x, y);
+        EMIT_UV(uv[0], uv[3]);
+
+        EMIT_POS(x + 1.0f, y);
+        EMIT_UV(uv[2], uv[3]);
+
+        EMIT_POS(x + 1.0f, y + 1.0f);
+        EMIT_UV(uv[2], uv[1]);
+
+        EMIT_POS(x, y + 1.0f);
+        EMIT_UV(uv[0], uv[1]);
+    }
+    return attr;
+}
+
 float* gpu_emitQuadScroll(float* attr, const float* drawRect,
                           const float* uvRect, float scrollSourceV)
 {
     float w = drawRect[2];
     float h = drawRect[3];
-    int i;
 
 #define EMIT_UVS(u,v,vunit) \
     *attr++ = u; \
@@ -935,19 +1101,13 @@ float* gpu_emitQuadScroll(float* attr, const float* drawRect,
     EMIT_UVS(uvRect[2], uvRect[3], 1.0f);
 
     // Top-right corner
-    for (i = 0; i < 2; ++i) {
-        EMIT_POS(drawRect[0] + w, drawRect[1] + h);
-        EMIT_UVS(uvRect[2], uvRect[1], 0.0f);
-    }
+    EMIT_POS(drawRect[0] + w, drawRect[1] + h);
+    EMIT_UVS(uvRect[2], uvRect[1], 0.0f);
 
     // Top-left corner
     EMIT_POS(drawRect[0], drawRect[1] + h);
     EMIT_UVS(uvRect[0], uvRect[1], 0.0f);
 
-    // Repeat first vertex
-    EMIT_POS(drawRect[0], drawRect[1]);
-    EMIT_UVS(uvRect[0], uvRect[3], 1.0f);
-
     return attr;
 }
 
@@ -956,7 +1116,6 @@ float* gpu_emitQuadFire(float* attr, const float* drawRect,
 {
     float w = drawRect[2];
     float h = drawRect[3];
-    int i;
 
 #define EMIT_UVF(u,v,uUnit,vUnit) \
     *attr++ = u; \
@@ -975,19 +1134,13 @@ float* gpu_emitQuadFire(float* attr, const float* drawRect,
     EMIT_UVF(uvRect[2], uvRect[3], 1.0f+uOff, 0.0f);
 
     // Top-right corner
-    for (i = 0; i < 2; ++i) {
-        EMIT_POS(drawRect[0] + w, drawRect[1] + h);
-        EMIT_UVF(uvRect[2], uvRect[1], 1.0f+uOff, 1.0f);
-    }
+    EMIT_POS(drawRect[0] + w, drawRect[1] + h);
+    EMIT_UVF(uvRect[2], uvRect[1], 1.0f+uOff, 1.0f);
 
     // Top-left corner
     EMIT_POS(drawRect[0], drawRect[1] + h);
     EMIT_UVF(uvRect[0], uvRect[1], uOff, 1.0f);
 
-    // Repeat first vertex
-    EMIT_POS(drawRect[0], drawRect[1]);
-    EMIT_UVF(uvRect[0], uvRect[3], uOff, 0.0f);
-
     return attr;
 }
 
@@ -995,7 +1148,6 @@ float* gpu_emitQuadFlag(float* attr, const float* drawRect)
 {
     float w = drawRect[2];
     float h = drawRect[3];
-    int i;
 
     // NOTE: We only do writes to attr here (avoid memcpy).
 
@@ -1008,19 +1160,13 @@ float* gpu_emitQuadFlag(float* attr, const float* drawRect)
     EMIT_UVF(1.0f, 0.0f, 2.0f, 0.0f);
 
     // Top-right corner
-    for (i = 0; i < 2; ++i) {
-        EMIT_POS(drawRect[0] + w, drawRect[1] + h);
-        EMIT_UVF(1.0f, 1.0f, 2.0f, 0.0f);
-    }
+    EMIT_POS(drawRect[0] + w, drawRect[1] + h);
+    EMIT_UVF(1.0f, 1.0f, 2.0f, 0.0f);
 
     // Top-left corner
     EMIT_POS(drawRect[0], drawRect[1] + h);
     EMIT_UVF(0.0f, 1.0f, 2.0f, 0.0f);
 
-    // Repeat first vertex
-    EMIT_POS(drawRect[0], drawRect[1]);
-    EMIT_UVF(0.0f, 0.0f, 2.0f, 0.0f);
-
     return attr;
 }
 
@@ -1042,20 +1188,29 @@ static void stopChunkAnimations(Animator* animator, MapFx* it, int count)
 }
 #endif
 
-void gpu_resetMap(void* res, const Map* map)
+/*
+ * Reset map rendering to use tile data other than map->data.
+ *
+ * \param map       Map which supplies the tileset.
+ * \param data      Tile ids of a width x height map.
+ * \param chunkDim  Chunk size in tiles.  The width & height must be a
+ *                  multiple of this.
+ */
+void gpu_resetMapData(void* res, const Map* map, const TileId* data,
+                      int width, int height, int chunkDim)
 {
     OpenGLResources* gr = (OpenGLResources*) res;
 
     gr->blockCount = 0;
-    gr->mapData    = map->data;
+    gr->mapData    = data;
     gr->renderData = map->tileset->render;
-    gr->mapW       = map->width;
-    gr->mapH       = map->height;
+    gr->mapW       = width;
+    gr->mapH       = height;
 
     // Initialize map chunks.
-    assert(map->chunk_height == map->chunk_width);
-    gr->mapChunkDim = map->chunk_width;
-    gr->mapChunkVertCount = gr->mapChunkDim * gr->mapChunkDim * 6;
+    gr->mapChunkDim = chunkDim;
+    gr->mapChunkVertCount = gr->mapChunkDim * gr->mapChunkDim * 4;
+    reserveQuadIndices(gr, gr->mapChunkDim * gr->mapChunkDim);
 
     for (int i = 0; i < CHUNK_CACHE_SIZE; ++i) {
         glBindBuffer(GL_ARRAY_BUFFER, gr->vbo[ GLOB_MAP_CHUNK0+i ]);
@@ -1075,6 +1230,13 @@ void gpu_resetMap(void* res, const Map* map)
     memset(gr->mapChunkFxUsed, 0, CHUNK_CACHE_SIZE*sizeof(uint16_t));
 }
 
+void gpu_resetMap(void* res, const Map* map)
+{
+    assert(map->chunk_height == map->chunk_width);
+    gpu_resetMapData(res, map, map->data, map->width, map->height,
+                     map->chunk_width);
+}
+
 struct ChunkLoc {
     int16_t x, y;
 };
@@ -1408,7 +1570,8 @@ void gpu_drawMap(void* res, const TileView* view, const float* tileUVs,
             glUniformMatrix4fv(gr->worldTrans, 1, GL_FALSE, matrix);
 
             glBindVertexArray(gr->vao[ GLOB_MAP_CHUNK0 + i ]);
-            glDrawArrays(GL_TRIANGLES, 0, gr->mapChunkVertCount);
+            glDrawElements(GL_TRIANGLES, gr->mapChunkVertCount / 4 * 6,
+                           GL_UNSIGNED_INT, 0);
 
             if (gr->mapChunkFxUsed[i])
                 fxUsed = 1;
@@ -1422,7 +1585,7 @@ void gpu_drawMap(void* res, const TileView* view, const float* tileUVs,
         const int MAPFX_LIST = GLOB_MAPFX_LIST0 / 2;
         float rect[4];
         float xoff, yoff;
-        float* fxAttr = gpu_beginTris(gr, MAPFX_LIST);
+        float* fxAttr = gpu_beginTris(gr, MAPFX_LIST, 4*CHUNK_FX_LIMIT);
         for (i = 0; i < 4; ++i) {
             if (usedMask & (1 << i) && gr->mapChunkFxUsed[i]) {
                 xoff = (float) (cloc[i].x - cx);
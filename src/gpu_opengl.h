@@ -17,6 +17,8 @@ enum GLObject {
     GLOB_GUI_LIST1,
     GLOB_HUD_LIST0,     // GPU_DLIST_HUD
     GLOB_HUD_LIST1,
+    GLOB_OVERLAY_LIST0, // GPU_DLIST_OVERLAY
+    GLOB_OVERLAY_LIST1,
 #ifdef GPU_RENDER
     GLOB_DRAW_LIST0,    // GPU_DLIST_VIEW_OBJ
     GLOB_DRAW_LIST1,
@@ -45,6 +47,7 @@ struct DrawList {
     int     buf;        // GLObject vbo index toggle.
     int     byteSize;
     GLsizei count;      // Number of floats.
+    GLsizei limit;      // Number of floats reserved by gpu_beginTris().
 };
 
 #define CHUNK_FX_LIMIT  8
@@ -67,6 +70,8 @@ struct OpenGLResources {
     GLuint shadowFbo;
     GLuint vbo[ GLOB_COUNT ];
     GLuint vao[ GLOB_COUNT ];
+    GLuint quadIndexBuf;        // Element buffer shared by all quad lists.
+    GLsizei quadIndexLimit;     // Number of quads in quadIndexBuf.
 
     float guiTexSize[2];
 
@@ -107,7 +112,7 @@ struct OpenGLResources {
     GLuint tilesMat;            // Managed by user.
     float  tilesVDim;
     float  time;
-    DrawList dl[5];
+    DrawList dl[6];
     float* dptr;
     const TileId* mapData;
     const TileRenderData* renderData;
@@ -120,7 +125,7 @@ struct OpenGLResources {
     uint16_t mapChunkFxUsed[4];
     MapFx mapChunkFx[4*CHUNK_FX_LIMIT];
 #else
-    DrawList dl[2];
+    DrawList dl[3];
     float* dptr;
 #endif
 };
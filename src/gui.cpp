@@ -19,6 +19,7 @@
 */
 
 #include <assert.h>
+#include <cstdlib>
 #include <cstring>
 #include "image32.h"
 #include "gpu.h"
@@ -98,7 +99,7 @@ static float* widget_button(float* attr, const GuiRect* wbox,
     ds->y = (float) wbox->y - ds->tf->descender * ds->psize + 0.3f * ds->psize;
     quadCount = txf_genText(ds, attr + 3, attr, ATTR_COUNT,
                             text, strlen((const char*) text));
-    return attr + (quadCount * 6 * ATTR_COUNT);
+    return attr + (quadCount * 4 * ATTR_COUNT);
 }
 
 static void label_size(SizeCon* size, TxfDrawState* ds, const uint8_t* text)
@@ -118,7 +119,7 @@ static float* widget_label(float* attr, const GuiRect* wbox, TxfDrawState* ds,
     ds->y = (float) wbox->y - ds->tf->descender * ds->psize;
     quadCount = txf_genText(ds, attr + 3, attr, ATTR_COUNT,
                             text, strlen((const char*) text));
-    return attr + (quadCount * 6 * ATTR_COUNT);
+    return attr + (quadCount * 4 * ATTR_COUNT);
 }
 
 static void list_size(SizeCon* size, TxfDrawState* ds, StringTable* st)
@@ -156,6 +157,17 @@ static void list_size(SizeCon* size, TxfDrawState* ds, StringTable* st)
     size->prefH = (int16_t) (fsize[1] * rows);
 }
 
+// Return the maximum number of glyph quads for a list.
+static int list_glyphCount(const StringTable* st)
+{
+    const StringEntry* it  = st->table;
+    const StringEntry* end = it + st->used;
+    int count = 0;
+    for (; it != end; ++it)
+        count += it->len;
+    return count;
+}
+
 static float* widget_list(float* attr, const GuiRect* wbox, TxfDrawState* ds,
                           StringTable* st)
 {
@@ -174,7 +186,7 @@ static float* widget_list(float* attr, const GuiRect* wbox, TxfDrawState* ds,
         ds->y -= ds->lineSpacing;
         quadCount = txf_genText(ds, attr + 3, attr, ATTR_COUNT,
                                 strings + it->start, it->len);
-        attr += quadCount * 6 * ATTR_COUNT;
+        attr += quadCount * 4 * ATTR_COUNT;
         ds->x = left;
     }
     return attr;
@@ -302,24 +314,12 @@ static void gui_setRootArea(LayoutBox* lo, const GuiRect* root)
 }
 
 /*
-  Create a GPU draw list for widgets using a bytecode language and a
-  two-pass layout algorithm.
-
-  The layout program must begin with a LAYOUT_* instruction and ends with a
-  paired LAYOUT_END instruction.
-
-  \param primList   The list identifier used with gpu_beginTris()/gpu_endTris().
-  \param root       A rectangular pixel area for this layout, or NULL to
-                    use screen size.
-  \param txfArr     Font list.
-  \param bytecode   A program of GuiOpcode instructions.
-  \param data       A pointer array of data referenced by bytecode program.
-
-  \return End primitive attribute pointer which caller must pass to
-          gpu_endTris().
+  Run the two-pass layout program.  The widget primitives are written to
+  the cache attr buffer if gc is not NULL, otherwise directly to primList.
 */
-float* gui_layout(int primList, const GuiRect* root, TxfDrawState* ds,
-                  const uint8_t* bytecode, const void** data)
+static float* gui_runLayout(GuiCache* gc, int primList, int extraQuads,
+                            const GuiRect* root, TxfDrawState* ds,
+                            const uint8_t* bytecode, const void** data)
 {
     SizeCon sconStack[MAX_SIZECON];
     LayoutBox loStack[LO_DEPTH];
@@ -329,6 +329,7 @@ float* gui_layout(int primList, const GuiRect* root, TxfDrawState* ds,
     float* attr;
     int arg;
     int areaWid;
+    int quadCount = extraQuads;
     GuiArea* areaArr = NULL;
     const uint8_t* pc;
     const void** dp;
@@ -339,7 +340,8 @@ float* gui_layout(int primList, const GuiRect* root, TxfDrawState* ds,
     scon = sconStack; \
     pc = bytecode; \
     dp = data; \
-    txf_begin(ds, 0, ds->fontTable[0]->fontSize, 0.0f, 0.0f)
+    txf_begin(ds, 0, ds->fontTable[0]->fontSize, 0.0f, 0.0f); \
+    ds->emitTris = 0
 
 
     // First pass to gather widget size information.
@@ -482,6 +484,7 @@ float* gui_layout(int primList, const GuiRect* root, TxfDrawState* ds,
 
         case BG_COLOR_CI:   // color-index
             pc++;
+            ++quadCount;
             break;
 
         // Widgets
@@ -491,6 +494,7 @@ float* gui_layout(int primList, const GuiRect* root, TxfDrawState* ds,
             break;
 
         case BUTTON_DT_S:
+            quadCount += 1 + strlen((const char*) *dp);
             button_size(scon, ds, (const uint8_t*) *dp++);
 layout_inc:
             layout_size(lo, sconStack + lo->nextPos, scon);
@@ -498,10 +502,12 @@ layout_inc:
             break;
 
         case LABEL_DT_S:
+            quadCount += strlen((const char*) *dp);
             label_size(scon, ds, (const uint8_t*) *dp++);
             goto layout_inc;
 
         case LIST_DT_ST:
+            quadCount += list_glyphCount((const StringTable*) *dp);
             list_size(scon, ds, (StringTable*) *dp++);
             goto layout_inc;
 
@@ -519,7 +525,16 @@ layout_done:
     // Second pass to create widget draw list.
     RESET_LAYOUT;
 
-    attr = gpu_beginTris(xu4.gpu, primList);
+    if (gc) {
+        int len = (quadCount - extraQuads) * 4 * ATTR_COUNT;
+        if (len > gc->attrAvail) {
+            free(gc->attr);
+            gc->attr = (float*) malloc(len * sizeof(float));
+            gc->attrAvail = len;
+        }
+        attr = gc->attr;
+    } else
+        attr = gpu_beginTris(xu4.gpu, primList, quadCount);
 
     for(;;) {
         switch (*pc++) {
@@ -752,6 +767,72 @@ done:
     return attr;
 }
 
+/*
+  Create a GPU draw list for widgets using a bytecode language and a
+  two-pass layout algorithm.
+
+  The layout program must begin with a LAYOUT_* instruction and ends with a
+  paired LAYOUT_END instruction.
+
+  \param primList   The list identifier used with gpu_beginTris()/gpu_endTris().
+  \param extraQuads Number of quads the caller will append to the list.
+  \param root       A rectangular pixel area for this layout, or NULL to
+                    use screen size.
+  \param txfArr     Font list.
+  \param bytecode   A program of GuiOpcode instructions.
+  \param data       A pointer array of data referenced by bytecode program.
+
+  \return End primitive attribute pointer which caller must pass to
+          gpu_endTris().
+*/
+float* gui_layout(int primList, int extraQuads, const GuiRect* root,
+                  TxfDrawState* ds, const uint8_t* bytecode, const void** data)
+{
+    return gui_runLayout(NULL, primList, extraQuads, root, ds, bytecode, data);
+}
+
+/*
+  Create a GPU draw list like gui_layout(), but reuse the widget primitives
+  generated by a previous call if the cache is valid and the layout area
+  is the same size.  Use gui_cacheInvalidate() when the widget data changes.
+
+  The STORE_* instructions are not run when the cache is used, so the areas
+  from the last layout remain in place.
+
+  The TxfDrawState is reset to font 0 for any text the caller appends.
+*/
+float* gui_layoutCached(GuiCache* gc, int primList, int extraQuads,
+                        const GuiRect* root, TxfDrawState* ds,
+                        const uint8_t* bytecode, const void** data)
+{
+    LayoutBox area;
+    float* attr;
+
+    gui_setRootArea(&area, root);
+
+    if (! gc->valid || gc->rootW != area.w || gc->rootH != area.h) {
+        attr = gui_runLayout(gc, primList, 0, root, ds, bytecode, data);
+        gc->attrLen = attr - gc->attr;
+        gc->rootW = area.w;
+        gc->rootH = area.h;
+        gc->valid = 1;
+    } else {
+        txf_begin(ds, 0, ds->fontTable[0]->fontSize, 0.0f, 0.0f);
+        ds->emitTris = 0;
+    }
+
+    attr = gpu_beginTris(xu4.gpu, primList,
+                         gc->attrLen / (4 * ATTR_COUNT) + extraQuads);
+    memcpy(attr, gc->attr, gc->attrLen * sizeof(float));
+    return attr + gc->attrLen;
+}
+
+void gui_cacheFree(GuiCache* gc)
+{
+    free(gc->attr);
+    memset(gc, 0, sizeof(GuiCache));
+}
+
 //----------------------------------------------------------------------------
 
 #include "btree2.c"
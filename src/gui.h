@@ -63,10 +63,26 @@ typedef struct {
     int wid;
 } GuiArea;
 
+// Retains the widget primitives made by gui_layoutCached().
+typedef struct {
+    float* attr;
+    int attrLen;                // Number of floats used in attr.
+    int attrAvail;
+    int16_t rootW, rootH;       // Size of layout area when attr was made.
+    int valid;
+} GuiCache;
+
+#define gui_cacheInit(gc)       memset(gc, 0, sizeof(GuiCache))
+#define gui_cacheInvalidate(gc) ((gc)->valid = 0)
+
 struct TxfDrawState;
 
-float* gui_layout(int primList, const GuiRect* root, TxfDrawState*,
+float* gui_layout(int primList, int extraQuads, const GuiRect* root,
+                  TxfDrawState*, const uint8_t* bytecode, const void** data);
+float* gui_layoutCached(GuiCache*, int primList, int extraQuads,
+                  const GuiRect* root, TxfDrawState*,
                   const uint8_t* bytecode, const void** data);
+void   gui_cacheFree(GuiCache*);
 void*  gui_areaTree(const GuiArea* areas, int count);
 const GuiArea* gui_pick(const void* tree, const GuiArea* areas,
                         uint16_t x, uint16_t y);
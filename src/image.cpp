@@ -10,6 +10,14 @@
 
 #include "support/image32.c"
 
+/*
+ * Record changes to the screenImage so only those areas are sent to the GPU.
+ */
+static inline void markDirty(const Image32* dest, int x, int y, int w, int h) {
+    if (dest == xu4.screenImage)
+        screenDirtyRect(x, y, w, h);
+}
+
 union RgbaInt {
     RGBA col;
     uint32_t u32;
@@ -137,6 +145,7 @@ void Image::putPixelIndex(int x, int y, uint32_t index) {
  */
 void Image::fill(const RGBA& col) {
     image32_fill(this, &col);
+    markDirty(this, 0, 0, w, h);
 }
 
 /**
@@ -150,6 +159,7 @@ void Image::fillRect(int x, int y, int rw, int rh, int r, int g, int b, int a) {
     int blitW, blitH;
 
     rgba_set(ri.col, r, g, b, a);
+    markDirty(this, x, y, rw, rh);
 
     blitW = rw;
     if ((blitW + x) > int(w))
@@ -201,6 +211,7 @@ void Image::getPixelIndex(int x, int y, unsigned int &index) const {
  */
 void Image::draw(int x, int y) const {
     image32_blit(xu4.screenImage, x, y, this, blending);
+    screenDirtyRect(x, y, w, h);
 }
 
 /**
@@ -209,6 +220,24 @@ void Image::draw(int x, int y) const {
  */
 void Image::drawSubRect(int x, int y, int rx, int ry, int rw, int rh) const {
     image32_blitRect(xu4.screenImage, x, y, this, rx, ry, rw, rh, blending);
+    screenDirtyRect(x, y, rw, rh);
+}
+
+/**
+ * Draws the image onto another image.
+ */
+void Image::drawOn(Image *d, int x, int y) const {
+    image32_blit(d, x, y, this, blending);
+    markDirty(d, x, y, w, h);
+}
+
+/**
+ * Draws a piece of the image onto another image.
+ */
+void Image::drawSubRectOn(Image *d, int x, int y,
+                          int rx, int ry, int rw, int rh) const {
+    image32_blitRect(d, x, y, this, rx, ry, rw, rh, blending);
+    markDirty(d, x, y, rw, rh);
 }
 
 /**
@@ -237,6 +266,8 @@ void Image::drawLetter(int dx, int dy, int sx, int sy, int sw, int sh,
     CLIP_SUB(dx, sx, sw, w, dest->w)
     CLIP_SUB(dy, sy, sh, h, dest->h)
 
+    screenDirtyRect(dx, dy, sw, sh);
+
     srow = pixels + w * sy + sx;
     drow = dest->pixels + dest->w * dy + dx;
 
@@ -290,32 +321,10 @@ void Image::drawLetter(int dx, int dy, int sx, int sy, int sw, int sh,
  * Draws a piece of the image flipped vertically onto another image.
  */
 void Image::drawSubRectInvertedOn(Image *dest, int x, int y, int rx, int ry, int rw, int rh) const {
-    uint32_t* dp;
-    uint32_t* drow;
-    const uint32_t* sp;
-    const uint32_t* send;
-    const uint32_t* srow;
-
     if (dest == NULL)
         dest = xu4.screenImage;
-
-    // Clip position and source rect to positive values.
-    CLIP_SUB(x, rx, rw, w, dest->w)
-    CLIP_SUB(y, ry, rh, h, dest->h)
-
-    srow = pixels + w * ry + rx;
-    drow = dest->pixels + dest->w * y + x;
-
-    srow += w * (rh - 1);
-    while (rh--) {
-        dp = drow;
-        sp = srow;
-        send = sp + rw;
-        while( sp != send )
-            *dp++ = *sp++;
-        drow += dest->w;
-        srow -= w;
-    }
+    image32_blitRectInverted(dest, x, y, this, rx, ry, rw, rh);
+    markDirty(dest, x, y, rw, rh);
 }
 
 /**
@@ -328,6 +337,7 @@ void Image::drawHighlight(int rx, int ry, int rw, int rh) {
 
     assert((rx+rw) <= w);
     assert((ry+rh) <= h);
+    markDirty(this, rx, ry, rw, rh);
 
     while (rh--) {
         cp = crow;
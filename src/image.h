@@ -66,16 +66,9 @@ public:
         drawSubRectInvertedOn(NULL, x, y, rx, ry, rw, rh);
     }
 
-    /** Draws the image onto another image. */
-    void drawOn(Image *d, int x, int y) const {
-        image32_blit(d, x, y, this, blending);
-    }
-
-    /** Draws a piece of the image onto another image. */
+    void drawOn(Image *d, int x, int y) const;
     void drawSubRectOn(Image *d, int x, int y,
-                       int rx, int ry, int rw, int rh) const {
-        image32_blitRect(d, x, y, this, rx, ry, rw, rh, blending);
-    }
+                       int rx, int ry, int rw, int rh) const;
 
     void drawSubRectInvertedOn(Image *d, int x, int y, int rx, int ry, int rw, int rh) const;
 
@@ -3,12 +3,15 @@
  */
 
 #include <string.h>
+#include <algorithm>
+#include <vector>
 
 #include "config.h"
 #include "error.h"
 #include "imageloader.h"
 #include "imagemgr.h"
 #include "intro.h"
+#include "parallel.h"
 #include "settings.h"
 #include "xu4.h"
 #include "gpu.h"
@@ -374,6 +377,17 @@ static Image* buildAtlas(ImageMgr* mgr, ImageInfo* atlas) {
     int count = xu4.config->atlasImages(atlas->filename, asiBuffer, maxChild);
     Image* image = Image::create(atlas->width, atlas->height);
 
+    // Decode all the child images at once.
+    {
+    Symbol childNames[maxChild] = { 0 };
+    n = 0;
+    for (i = 0; i < count; ++i) {
+        if (asiBuffer[i].name >= AEDIT_OP_COUNT)
+            childNames[n++] = asiBuffer[i].name;
+    }
+    mgr->preload(childNames, n);
+    }
+
     rgba_set(brush, 255, 0, 255, 255);
 
     // Blit the child images and count the total number of SubImages.
@@ -481,6 +495,12 @@ static Image* buildAtlas(ImageMgr* mgr, ImageInfo* atlas) {
 }
 #endif
 
+enum DecodeStatus {
+    DECODE_OK,
+    DECODE_NO_FILE,
+    DECODE_FAILED
+};
+
 ImageInfo* ImageMgr::load(ImageInfo* info) {
 #ifdef CONF_MODULE
     if (info->filetype == FTYPE_ATLAS) {
@@ -490,88 +510,77 @@ ImageInfo* ImageMgr::load(ImageInfo* info) {
     }
 #endif
 
+    int status;
+    Image* unscaled = decode(info, &status);
+    return finishLoad(info, unscaled, status);
+}
+
+/*
+ * Read the image file and apply any fixups which only modify the image
+ * itself.
+ *
+ * This is called from worker threads by preload() so it must not touch
+ * any ImageMgr state other than info.
+ */
+Image* ImageMgr::decode(ImageInfo* info, int* status) {
     U4FILE *file = getImageFile(info);
-    Image *unscaled = NULL;
-    if (file) {
-        //printf( "ImageMgr load %d:%s\n", resGroup, info->filename.c_str() );
-
-        unscaled = loadImage(file, info->filetype, info->width, info->height,
-                             (info->fixup == FIXUP_ABYSS) ? BPP_CLUT8
-                                                          : info->depth);
-        u4fclose(file);
-
-        if (! unscaled) {
-            errorWarning("Can't load image \"%s\" with type %d",
-                         xu4.config->confString(info->filename), info->filetype);
-            return info;
-        }
+    Image *unscaled;
+    if (! file) {
+        *status = DECODE_NO_FILE;
+        return NULL;
+    }
 
-        info->resGroup = resGroup;
-        if (info->width == -1) {
-            // Write in the values for later use.
-            info->width  = unscaled->width();
-            info->height = unscaled->height();
-        }
+    //printf( "ImageMgr load %d:%s\n", resGroup, info->filename.c_str() );
 
-        // Pre-compute tile UVs.
-        if (info->tiles > 1 && info->tileTexCoord == NULL ) {
-            // Assuming image is one tile wide.
-            float iwf = (float) unscaled->width();
-            float ihf = (float) unscaled->height();
-            float tileH = iwf;
-            float tileY = 0.0f;
-            float *uv;
-            int tileCount = info->tiles;
-
-            info->tileTexCoord = uv = new float[tileCount * 4];
-            for (int i = 0; i < tileCount; ++i) {
-                *uv++ = 0.0f;
-                *uv++ = tileY / ihf;
-                *uv++ = 1.0f;
-                *uv++ = (tileY + tileH) / ihf;
-                tileY += tileH;
-            }
-        }
-        /*
-        SubImage* simg = (SubImage*) info->subImages;
-        SubImage* end = simg + info->subImageCount;
-        while (simg != end) {
-            simg->u0 = simg->x / iwf;
-            simg->v0 = simg->y / ihf;
-            simg->u1 = (simg->x + simg->width) / iwf;
-            simg->v1 = (simg->y + simg->height) / ihf;
-            ++simg;
-        }
-        */
+    unscaled = loadImage(file, info->filetype, info->width, info->height,
+                         (info->fixup == FIXUP_ABYSS) ? BPP_CLUT8
+                                                      : info->depth);
+    u4fclose(file);
 
-#if 0
-        string out("/tmp/xu4/");
-        out.append(xu4.config->symbolName(info->name));
-        unscaled->save(out.append(".ppm").c_str());
-#endif
-    }
-    else
-    {
-        errorWarning("Failed to open file %s for reading.",
-                     xu4.config->confString(info->filename));
+    if (! unscaled) {
+        *status = DECODE_FAILED;
         return NULL;
     }
+    *status = DECODE_OK;
 
-    if (unscaled == NULL)
-        return NULL;
+    if (info->width == -1) {
+        // Write in the values for later use.
+        info->width  = unscaled->width();
+        info->height = unscaled->height();
+    }
+
+    // Pre-compute tile UVs.
+    if (info->tiles > 1 && info->tileTexCoord == NULL ) {
+        // Assuming image is one tile wide.
+        float iwf = (float) unscaled->width();
+        float ihf = (float) unscaled->height();
+        float tileH = iwf;
+        float tileY = 0.0f;
+        float *uv;
+        int tileCount = info->tiles;
+
+        info->tileTexCoord = uv = new float[tileCount * 4];
+        for (int i = 0; i < tileCount; ++i) {
+            *uv++ = 0.0f;
+            *uv++ = tileY / ihf;
+            *uv++ = 1.0f;
+            *uv++ = (tileY + tileH) / ihf;
+            tileY += tileH;
+        }
+    }
+
+#if 0
+    string out("/tmp/xu4/");
+    out.append(xu4.config->symbolName(info->name));
+    unscaled->save(out.append(".ppm").c_str());
+#endif
 
     /*
      * fixup the image before scaling it
+     * (FIXUP_INTRO & FIXUP_ABYSS depend on other images so are done in
+     * finishLoad).
      */
     switch (info->fixup) {
-    case FIXUP_NONE:
-        break;
-    case FIXUP_INTRO:
-        fixupIntro(unscaled);
-        break;
-    case FIXUP_ABYSS:
-        fixupAbyssVision(unscaled);
-        break;
     case FIXUP_ABACUS:
         fixupAbacus(unscaled);
         break;
@@ -602,6 +611,37 @@ ImageInfo* ImageMgr::load(ImageInfo* info) {
             }
         }
         break;
+    default:
+        break;
+    }
+    return unscaled;
+}
+
+/*
+ * Complete loading of an image returned by decode().  This must be called
+ * from the main thread in the order the images are wanted.
+ */
+ImageInfo* ImageMgr::finishLoad(ImageInfo* info, Image* unscaled, int status) {
+    if (status == DECODE_NO_FILE) {
+        errorWarning("Failed to open file %s for reading.",
+                     xu4.config->confString(info->filename));
+        return NULL;
+    }
+    if (status == DECODE_FAILED) {
+        errorWarning("Can't load image \"%s\" with type %d",
+                     xu4.config->confString(info->filename), info->filetype);
+        return info;
+    }
+
+    info->resGroup = resGroup;
+
+    switch (info->fixup) {
+    case FIXUP_INTRO:
+        fixupIntro(unscaled);
+        break;
+    case FIXUP_ABYSS:
+        fixupAbyssVision(unscaled);
+        break;
     }
 
 #if 0
@@ -616,6 +656,84 @@ ImageInfo* ImageMgr::load(ImageInfo* info) {
     return info;
 }
 
+struct PreloadJob {
+    ImageMgr* mgr;
+    ImageInfo** info;
+    Image** image;
+    int* status;
+};
+
+void ImageMgr::decodeFunc(void* user, int i) {
+    PreloadJob* job = (PreloadJob*) user;
+    job->image[i] = job->mgr->decode(job->info[i], job->status + i);
+}
+
+/**
+ * Load a number of images (or the images holding the named sub-images)
+ * into the current resource group.
+ *
+ * The files are read and decoded on all available cores; only the fixups
+ * which depend on other images and any texture uploads are done on the
+ * calling thread.  Images which are already loaded are skipped.
+ */
+void ImageMgr::preload(const Symbol* names, int count) {
+    std::vector<ImageInfo*> pending;
+    std::vector<ImageInfo*> atlases;
+    ImageInfo* info;
+    int i, n;
+
+    if (! baseSet)
+        return;
+
+    for (i = 0; i < count; ++i) {
+        info = findInfo(names[i]);
+        if (! info || info->image)
+            continue;
+        std::vector<ImageInfo*>& list =
+            (info->filetype == FTYPE_ATLAS) ? atlases : pending;
+        if (std::find(list.begin(), list.end(), info) == list.end())
+            list.push_back(info);
+    }
+
+    n = pending.size();
+    if (n) {
+        std::vector<Image*> image(n);
+        std::vector<int> status(n);
+        PreloadJob job;
+
+        // Create the shared palettes before the workers use them.
+        vgaPalette();
+        greyPalette();
+
+        job.mgr    = this;
+        job.info   = &pending[0];
+        job.image  = &image[0];
+        job.status = &status[0];
+        parallel_for(n, decodeFunc, &job);
+
+        for (i = 0; i < n; ++i)
+            finishLoad(pending[i], image[i], status[i]);
+    }
+
+    for (i = 0; i < (int) atlases.size(); ++i)
+        load(atlases[i]);
+}
+
+/*
+ * Return the ImageInfo for an image or the image holding a sub-image
+ * without loading it.
+ */
+ImageInfo* ImageMgr::findInfo(Symbol name) {
+    std::map<Symbol, ImageInfo *>::iterator it = baseSet->info.find(name);
+    if (it != baseSet->info.end())
+        return it->second;
+
+    ImageInfo* info;
+    if (getSubImage(name, &info))
+        return info;
+    return NULL;
+}
+
 /**
  * Returns information for the given image set.
  */
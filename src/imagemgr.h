@@ -196,6 +196,7 @@ public:
 
     ImageInfo* imageInfo(Symbol name, const SubImage** subPtr);
     ImageInfo* get(Symbol name);
+    void preload(const Symbol* names, int count);
 
     uint16_t setResourceGroup(uint16_t group);
     void freeResourceGroup(uint16_t group);
@@ -206,8 +207,12 @@ public:
 
 private:
     static void notice(int, void*, void*);
+    static void decodeFunc(void*, int);
     const SubImage* getSubImage(Symbol name, ImageInfo** infoPtr);
+    ImageInfo* findInfo(Symbol name);
     ImageInfo* load(ImageInfo* info);
+    Image* decode(ImageInfo* info, int* status);
+    ImageInfo* finishLoad(ImageInfo* info, Image* unscaled, int status);
     U4FILE * getImageFile(ImageInfo *info);
 
     void fixupIntro(Image *im);
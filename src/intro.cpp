@@ -14,6 +14,7 @@
 #include "imagemgr.h"
 #include "sound.h"
 #include "party.h"
+#include "savewriter.h"
 #include "screen.h"
 #include "settings.h"
 #include "tileset.h"
@@ -332,6 +333,15 @@ bool IntroController::init() {
     binData = new IntroBinData();
     binData->load();
 
+    {
+    const Symbol introImages[] = {
+        BKGD_INTRO, BKGD_OPTIONS_TOP, BKGD_OPTIONS_BTM, BKGD_ANIMATE,
+        IMG_MOONGATE, IMG_ITEMS, IMG_WHITEBEAD, IMG_BLACKBEAD
+    };
+    xu4.imageMgr->preload(introImages,
+                          sizeof(introImages) / sizeof(Symbol));
+    }
+
     Symbol sym[2];
     xu4.config->internSymbols(sym, 2, "beast0frame00 beast1frame00");
     beastiesImg = xu4.imageMgr->get(BKGD_ANIMATE);  // Assign resource group.
@@ -889,6 +899,12 @@ void IntroController::finishInitiateGame(const string &nameBuffer, SexType sex)
     {
     uint16_t saveGroup = xu4.imageMgr->setResourceGroup(StageIntro);
 
+    const Symbol storyImages[] = {
+        BKGD_TREE, BKGD_PORTAL, BKGD_OUTSIDE, BKGD_INSIDE, BKGD_WAGON,
+        BKGD_GYPSY, BKGD_ABACUS
+    };
+    xu4.imageMgr->preload(storyImages, sizeof(storyImages) / sizeof(Symbol));
+
     ImageInfo* tree = xu4.imageMgr->get(BKGD_TREE);
     egaGraphics = tree && (tree->getFilename().compare(0, 3, "u4/") == 0);
 
@@ -910,6 +926,8 @@ void IntroController::finishInitiateGame(const string &nameBuffer, SexType sex)
     delete xu4.saveGame;
     xu4.saveGame = NULL;    // Make GameController::init() reload the game.
 
+    savewriter_wait();      // Don't let a pending save replace the new game.
+
     FILE *saveGameFile = fopen((xu4.settings->getUserPath() + PARTY_SAV).c_str(), "wb");
     if (!saveGameFile) {
         questionArea.hideCursor();
@@ -28,33 +28,34 @@
  * string searches), there is no reason not to implement it as a simple array in the decoder.
  * But since U4 uses a hash table in the decoder, this C version must do the same (or it won't be
  * able to decode the U4 files).
+ * The decoder below keeps the hash placement (it decides which codeword a new
+ * string receives) but otherwise works on a direct-indexed table: every entry
+ * records its string length and first character, so strings are written
+ * straight to the output without an intermediate stack, and the size-only
+ * pass never needs to walk the prefix chains at all.
  * An article on LZW data (de)compression can be found here:
  * https://marknelson.us/posts/1989/10/01/lzw-data-compression.html
  *
  */
 
 #include "lzw.h"
-#include "hash.h"
-#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 
-typedef void (*WRITE_DECOMP)(unsigned char root, unsigned char *destination, long* position);
+/* re-initialize the dictionary when there are more than 0xccc entries */
+#define MAX_DICT_ENTRIES    0xccc
+#define DICT_SIZE           0x1000
 
-typedef struct _lzwDictionaryEntry
+typedef struct
 {
-    unsigned char root;
-    int codeword;
-    unsigned char occupied;
-} lzwDictionaryEntry;
+    uint16_t prefix[DICT_SIZE];     /* codeword of the string minus its last character */
+    uint16_t length[DICT_SIZE];     /* string length in bytes */
+    uint8_t  suffix[DICT_SIZE];     /* last character (the "root" of the entry) */
+    uint8_t  first[DICT_SIZE];      /* first character of the string */
+    uint8_t  occupied[DICT_SIZE];
+} lzwDictionary;
 
-long generalizedDecompress(WRITE_DECOMP outFunc, unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize);
-int getNextCodeword(long* bitsRead, unsigned char *compressedMem);
-void discardRoot(unsigned char root, unsigned char *destination, long* position);
-void outputRoot(unsigned char root, unsigned char *destination, long* position);
-
-void getString(int codeword, lzwDictionaryEntry *lzwDictionary, unsigned char* stack, int *elementsInStack);
-int getNewHashCode(unsigned char root, int codeword, lzwDictionaryEntry* dictionary);
-unsigned char hashPosFound(int hashCode, unsigned char root, int codeword, lzwDictionaryEntry* dictionary);
+static long generalizedDecompress(const unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize);
 
 /*
  * This function returns the decompressed size of a block of compressed data.
@@ -69,7 +70,7 @@ unsigned char hashPosFound(int hashCode, unsigned char root, int codeword, lzwDi
  */
 long lzwGetDecompressedSize(unsigned char* compressedMem, long compressedSize)
 {
-    return(generalizedDecompress(&discardRoot, compressedMem, NULL, compressedSize));
+    return(generalizedDecompress(compressedMem, NULL, compressedSize));
 }
 
 /*
@@ -85,7 +86,7 @@ long lzwGetDecompressedSize(unsigned char* compressedMem, long compressedSize)
  */
 long lzwDecompress(unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize)
 {
-    return(generalizedDecompress(&outputRoot, compressedMem, decompressedMem, compressedSize));
+    return(generalizedDecompress(compressedMem, decompressedMem, compressedSize));
 }
 
 /* --------------------------------------------------------------------------------------
@@ -93,245 +94,189 @@ long lzwDecompress(unsigned char* compressedMem, unsigned char* decompressedMem,
    -------------------------------------------------------------------------------------- */
 
 /*
- * This function does the actual decompression work.
- * Parameters:
- * perform_decompression: FALSE ==> return decompressed size, but discard decompressed data
- * compressed_mem: compressed data
- * decompressed_mem: this is where the compressed data will be decompressed to
- * compressed_size: size of the compressed data (in bytes)
+ * These are the probes from hash.c, inlined.  The secondary probe emulates
+ * a 16-bit mul followed by two rcl's through DX:AX.  As AX is always >= 0x800
+ * the product overflows into DX and sets the carry, which the rotates shift
+ * into the low bits that are masked off, leaving a plain shift of the square.
  */
-long generalizedDecompress(WRITE_DECOMP outFunc, unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize)
-{
-    int i;
-
-    /* re-initialize the dictionary when there are more than 0xccc entries */
-    const int maxDictEntries = 0xccc;
-
-    const int lzwStackSize = 0x8000;
-    const int lzwDictionarySize = 0x1000;
-
-    int old_code;
-    int new_code;
-    unsigned char character;
-
-    long bitsRead = 0;
-    long bytesWritten = 0;
-
-    /* newpos: position in the dictionary where new codeword was added                      */
-    /* must be equal to current codeword (if it isn't, the compressed data must be corrupt) */
-    /* unknownCodeword: is the current codeword in the dictionary?                          */
-    int newpos;
-    unsigned char unknownCodeword;
-
-    /* initialize the dictionary and the stack */
-    lzwDictionaryEntry *lzwDictionary = (lzwDictionaryEntry *) malloc(sizeof(lzwDictionaryEntry) * lzwDictionarySize);
-    int codewordsInDictionary = 0;
-    unsigned char *lzwStack = (unsigned char *) malloc(sizeof(unsigned char) * lzwStackSize);
-    int elementsInStack = 0;
-
-    /* clear the dictionary */
-    memset(lzwDictionary, 0, sizeof(lzwDictionaryEntry) * lzwDictionarySize);
-    for (i = 0; i < 0x100; i++)
-    {
-        lzwDictionary[i].occupied = 1;
-    }
-
-    if (bitsRead + 12 <= compressedSize * 8)
-    {
-        /* read OLD_CODE */
-        old_code = getNextCodeword(&bitsRead, compressedMem);
-        /* CHARACTER = OLD_CODE */
-        character = (unsigned char)old_code;
-        /* output OLD_CODE */
-        outFunc(character, decompressedMem, &bytesWritten);
-
-        while (bitsRead + 12 <= compressedSize * 8) /* WHILE there are still input characters DO */
-        {
-            /* read NEW_CODE */
-            new_code = getNextCodeword(&bitsRead, compressedMem);
-
-            if (lzwDictionary[new_code].occupied)   /* is the codeword in the dictionary? */
-            {
-                /* codeword is present in the dictionary                                               */
-                /* it must either be a root or a non-root that has already been added to the dicionary */
-                unknownCodeword = 0;
-
-                /* STRING = get translation of NEW_CODE */
-                getString(new_code,lzwDictionary,lzwStack,&elementsInStack);
-            }
-            else
-            {
-                /* codeword is yet to be defined */
-                unknownCodeword = 1;
-
-                /* STRING = get translation of OLD_CODE */
-                /* STRING = STRING+CHARACTER            */
-                lzwStack[elementsInStack] = character;   /* push character on the stack */
-                elementsInStack++;
-
-                getString(old_code,lzwDictionary,lzwStack,&elementsInStack);
-            }
-
-            /* CHARACTER = first character in STRING */
-            character = lzwStack[elementsInStack-1];   /* element at top of stack */
-
-            /* output STRING */
-            while (elementsInStack > 0)
-            {
-                outFunc(lzwStack[elementsInStack-1], decompressedMem, &bytesWritten);
-                elementsInStack--;
-            }
-
-            /* add OLD_CODE + CHARACTER to the translation table */
-            newpos = getNewHashCode(character,old_code,lzwDictionary);
-
-            lzwDictionary[newpos].root = character;
-            lzwDictionary[newpos].codeword = old_code;
-            lzwDictionary[newpos].occupied = 1;
-            codewordsInDictionary++;
-
-            /* check for errors */
-            if (unknownCodeword && (newpos != new_code))
-            {
-                /* clean up */
-                free(lzwStack);
-                free(lzwDictionary);
-
-                return(-1);
-            }
-
-            if (codewordsInDictionary > maxDictEntries)
-            {
-                /* wipe dictionary */
-                codewordsInDictionary = 0;
-                memset(lzwDictionary, 0, sizeof(lzwDictionaryEntry) * lzwDictionarySize);
-                for (i = 0; i < 0x100; i++)
-                {
-                    lzwDictionary[i].occupied = 1;
-                }
-
-                if (bitsRead + 12 <= compressedSize * 8)
-                {
-                    new_code = getNextCodeword(&bitsRead, compressedMem);
-                    character = (unsigned char)new_code;
-
-                    outFunc(character, decompressedMem, &bytesWritten);
-                }
-                else
-                {
-                    /* clean up */
-                    free(lzwStack);
-                    free(lzwDictionary);
-
-                    return(bytesWritten);
-                }
-            }
-
-            /* OLD_CODE = NEW_CODE */
-            old_code = new_code;
-        }
-    }    
-    /* clean up */
-    free(lzwStack);
-    free(lzwDictionary);
+#define PROBE1(root, codeword)  ((((root) << 4) ^ (codeword)) & 0xfff)
+#define PROBE3(hashCode)        (((hashCode) + 0x1fd) & 0xfff)
 
-    return(bytesWritten);
-}
-
-/* read the next 12-bit codeword from the compressed data */
-int getNextCodeword(long* bitsRead, unsigned char *compressedMem)
+static inline int probe2Inline(int root, int codeword)
 {
-    int codeword = (compressedMem[(*bitsRead)/8] << 8) + compressedMem[(*bitsRead)/8+1];
-    codeword = codeword >> (4-((*bitsRead)%8));
-    codeword = codeword & 0xfff;
-    (*bitsRead) += 12;
-
-    return(codeword);
+    uint32_t ax = ((root << 1) + codeword) | 0x800;
+    return (int) (((ax * ax) >> 6) & 0xfff);
 }
 
-/* increment position pointer, but do not write root to memory */
-void discardRoot(unsigned char root, unsigned char *destination, long* position)
+/* Is hashCode a free slot or one already holding the (root, codeword) pair? */
+static inline int hashPosFound(const lzwDictionary* dict, int hashCode, int root, int codeword)
 {
-    (*position)++;
+    if (hashCode <= 0xff)       /* hash codes must not be roots */
+        return 0;
+    if (! dict->occupied[hashCode])
+        return 1;
+    return dict->suffix[hashCode] == root && dict->prefix[hashCode] == codeword;
 }
 
-/* output a root to memory */
-void outputRoot(unsigned char root, unsigned char *destination, long* position)
-{
-    destination[*position] = root;
-    (*position)++;
-}
-
-/* --------------------------------------------------------------------------------------
-   Dictionary-related functions
-   -------------------------------------------------------------------------------------- */
-
-/* pushes the string associated with codeword onto the stack */
-void getString(int codeword, lzwDictionaryEntry *dictionary, unsigned char *stack, int *elementsInStack)
+static int getNewHashCode(const lzwDictionary* dict, int root, int codeword)
 {
-    unsigned char root;
-    int currentCodeword = codeword;
+    int hashCode = PROBE1(root, codeword);
+    if (hashPosFound(dict, hashCode, root, codeword))
+        return hashCode;
 
-    while (currentCodeword > 0xff)
-    {
-        root = dictionary[currentCodeword].root;
-        currentCodeword = dictionary[currentCodeword].codeword;
-        stack[*elementsInStack] = root;
-        (*elementsInStack)++;
-    }
+    hashCode = probe2Inline(root, codeword);
+    if (hashPosFound(dict, hashCode, root, codeword))
+        return hashCode;
 
-    /* push the root at the leaf */
-    stack[*elementsInStack] = (unsigned char)currentCodeword;
-    (*elementsInStack)++;
+    do {
+        hashCode = PROBE3(hashCode);
+    } while (! hashPosFound(dict, hashCode, root, codeword));
+    return hashCode;
 }
 
-int getNewHashCode (unsigned char root, int codeword, lzwDictionaryEntry *dictionary)
+static void resetDictionary(lzwDictionary* dict)
 {
-    int hashCode;
+    memset(dict->occupied + 0x100, 0, DICT_SIZE - 0x100);
+}
 
-    /* probe 1 */
-    hashCode = probe1(root, codeword);
-    if (hashPosFound(hashCode, root, codeword, dictionary)) {
-        return(hashCode);
-    }
-    /* probe 2 */
-    hashCode = probe2(root, codeword);
-    if (hashPosFound(hashCode, root, codeword, dictionary)) {
-        return(hashCode);
-    }
-    /* probe 3 */
-    do {
-        hashCode = probe3(hashCode);
+/*
+ * Write the string of codeword to dest (which must have room for
+ * dict->length[codeword] bytes), filling from the last character backwards.
+ */
+static inline void writeString(const lzwDictionary* dict, int codeword, unsigned char* dest)
+{
+    int n = dict->length[codeword];
+    dest += n;
+    while (n--) {
+        *--dest = dict->suffix[codeword];
+        codeword = dict->prefix[codeword];
     }
-    while (! hashPosFound(hashCode, root, codeword, dictionary));
-
-    return(hashCode);
 }
 
-unsigned char hashPosFound(int hashCode, unsigned char root, int codeword, lzwDictionaryEntry* dictionary)
+/*
+ * This function does the actual decompression work.
+ * Parameters:
+ * compressedMem: compressed data
+ * decompressedMem: this is where the compressed data will be decompressed to.
+ *                  If NULL, only the decompressed size is computed.
+ * compressedSize: size of the compressed data (in bytes)
+ */
+static long generalizedDecompress(const unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize)
 {
-    if (hashCode > 0xff)   /* hash codes must not be roots */
+    lzwDictionary dict;
+    const unsigned char* in = compressedMem;
+    const unsigned char* inEnd = compressedMem + compressedSize;
+    uint64_t bitBuf = 0;        /* MSB-aligned bit buffer */
+    int bitCount = 0;
+    long codesLeft = (compressedSize * 8) / 12;
+    long bytesWritten = 0;
+    int codewordsInDictionary = 0;
+    int old_code, new_code, newpos, len, i;
+    int unknownCodeword;
+    uint8_t character;
+
+/* Read the next 12-bit codeword, refilling the bit buffer a byte at a time. */
+#define NEXT_CODEWORD(cw) \
+    if (bitCount < 12) { \
+        while (bitCount <= 56 && in != inEnd) { \
+            bitBuf |= (uint64_t) *in++ << (56 - bitCount); \
+            bitCount += 8; \
+        } \
+    } \
+    cw = (int) (bitBuf >> 52); \
+    bitBuf <<= 12; \
+    bitCount -= 12; \
+    --codesLeft
+
+    /* The roots are never overwritten; only entries above them are reset. */
+    for (i = 0; i < 0x100; i++)
     {
-        unsigned char c1, c2, c3;
+        dict.prefix[i] = 0;
+        dict.length[i] = 1;
+        dict.suffix[i] = dict.first[i] = (uint8_t) i;
+        dict.occupied[i] = 1;
+    }
+    resetDictionary(&dict);
+
+    if (codesLeft <= 0)
+        return 0;
+
+    /* read OLD_CODE */
+    NEXT_CODEWORD(old_code);
+    if (old_code > 0xff)
+        return -1;              /* the first codeword is always a root */
+    /* CHARACTER = OLD_CODE */
+    character = (uint8_t) old_code;
+    /* output OLD_CODE */
+    if (decompressedMem)
+        decompressedMem[bytesWritten] = character;
+    bytesWritten++;
+
+    while (codesLeft > 0)   /* WHILE there are still input characters DO */
+    {
+        /* read NEW_CODE */
+        NEXT_CODEWORD(new_code);
 
-        if (dictionary[hashCode].occupied)
+        unknownCodeword = ! dict.occupied[new_code];
+        if (! unknownCodeword)
         {
-            /* hash table position is occupied */
-            c1 = 1;
-            /* is our (root,codeword) pair already in the hash table? */
-            c2 = dictionary[hashCode].root == root;
-            c3 = dictionary[hashCode].codeword == codeword;
+            /* STRING = get translation of NEW_CODE; output STRING */
+            len = dict.length[new_code];
+            if (decompressedMem)
+                writeString(&dict, new_code, decompressedMem + bytesWritten);
+            /* CHARACTER = first character in STRING */
+            character = dict.first[new_code];
         }
         else
         {
-            /* hash table position is free */
-            c1 = 0;
+            /* codeword is yet to be defined */
+            /* STRING = get translation of OLD_CODE + CHARACTER; output STRING */
+            len = dict.length[old_code] + 1;
+            if (decompressedMem)
+            {
+                writeString(&dict, old_code, decompressedMem + bytesWritten);
+                decompressedMem[bytesWritten + len - 1] = character;
+            }
+            character = dict.first[old_code];
         }
+        bytesWritten += len;
 
-        return((!c1) || (c1 && c2 && c3));
-    }
-    else
-    {
-        return(0);
+        /* add OLD_CODE + CHARACTER to the translation table */
+        newpos = getNewHashCode(&dict, character, old_code);
+
+        dict.prefix[newpos]   = (uint16_t) old_code;
+        dict.suffix[newpos]   = character;
+        dict.first[newpos]    = dict.first[old_code];
+        dict.length[newpos]   = dict.length[old_code] + 1;
+        dict.occupied[newpos] = 1;
+        codewordsInDictionary++;
+
+        /* check for errors; the new entry must be the undefined codeword */
+        if (unknownCodeword && (newpos != new_code))
+            return -1;
+
+        if (codewordsInDictionary > MAX_DICT_ENTRIES)
+        {
+            /* wipe dictionary */
+            codewordsInDictionary = 0;
+            resetDictionary(&dict);
+
+            if (codesLeft <= 0)
+                return bytesWritten;
+
+            NEXT_CODEWORD(new_code);
+            if (new_code > 0xff)
+                return -1;
+            character = (uint8_t) new_code;
+            if (decompressedMem)
+                decompressedMem[bytesWritten] = character;
+            bytesWritten++;
+        }
+
+        /* OLD_CODE = NEW_CODE */
+        old_code = new_code;
     }
+#undef NEXT_CODEWORD
+
+    return bytesWritten;
 }
@@ -104,11 +104,9 @@ long decompress_u4_memory(void *in, long inlen, void **out) {
     }
 
     /* decompress file from compressed_mem[] into decompressed_mem[] */
+    /* (every byte is written by the decoder so there is no need to clear it) */
     decompressed_mem = (unsigned char *) malloc(decompressed_filesize);
 
-    /* testing: clear destination mem */
-    memset(decompressed_mem, 0, decompressed_filesize);
-
     errorCode = lzwDecompress(compressed_mem, decompressed_mem, compressed_filesize);
 
     *out = decompressed_mem;
@@ -29,15 +29,12 @@
 
 #include <stdio.h>
 #include <cstdlib>
+#include <stdint.h>
 
 #include "u6decode.h"
-#include "u6stack.h"
-#include "u6dict.h"
 
 using namespace U6Decode;
 
-Dict dict;
-
 unsigned char U6Decode::read1(FILE *f) {
     return(fgetc(f));
 }
@@ -97,148 +94,141 @@ long U6Decode::get_uncompressed_size(FILE *input_file) {
     }
 }
 
-// ----------------------------------------------
-// Read the next code word from the source buffer
-// ----------------------------------------------
-int U6Decode::get_next_codeword (long& bits_read, unsigned char *source, int codeword_size) {
-    unsigned char b0,b1,b2;
-    int codeword;
-   
-    b0 = source[bits_read/8];
-    b1 = source[bits_read/8+1];
-    b2 = source[bits_read/8+2];
-
-    codeword = ((b2 << 16) + (b1 << 8) + b0);
-    codeword = codeword >> (bits_read % 8);
-    switch (codeword_size) {
-    case 0x9:
-        codeword = codeword & 0x1ff;
-        break;
-    case 0xa:
-        codeword = codeword & 0x3ff;
-        break;
-    case 0xb:
-        codeword = codeword & 0x7ff;
-        break;
-    case 0xc:
-        codeword = codeword & 0xfff;
-        break;
-    default:
-        printf("Error: weird codeword size!\n");
-        break;
-    }
-    bits_read += codeword_size;
-
-    return (codeword);
-}
-
-void U6Decode::output_root(unsigned char root, unsigned char *destination, long& position) {
-    destination[position] = root;
-    position++;   
+// -----------------------------------------------------------------------------
+// The dictionary is indexed directly by codeword.  Each entry records the
+// length and first character of its string so strings can be written straight
+// to the destination (back to front) without an intermediate stack.
+// -----------------------------------------------------------------------------
+namespace U6Decode {
+    enum {
+        DICT_SIZE = 0x1000,
+        CODE_CLEAR = 0x100,
+        CODE_END = 0x101,
+        CODE_FIRST_FREE = 0x102
+    };
+
+    struct Dict {
+        uint16_t prefix[DICT_SIZE];
+        uint16_t length[DICT_SIZE];
+        uint8_t  suffix[DICT_SIZE];
+        uint8_t  first[DICT_SIZE];
+    };
 }
 
-void U6Decode::get_string(Stack &stack, int codeword) {
-    unsigned char root;
-    int current_codeword;
-   
-    current_codeword = codeword;
-    while (current_codeword > 0xff)
-        {
-            root = dict.get_root(current_codeword);
-            current_codeword = dict.get_codeword(current_codeword);
-            stack.push(root);
-        }
-
-    // push the root at the leaf
-    stack.push((unsigned char)current_codeword);
+static inline void write_string(const Dict& dict, int codeword, unsigned char *dest) {
+    int n = dict.length[codeword];
+    dest += n;
+    while (n--) {
+        *--dest = dict.suffix[codeword];
+        codeword = dict.prefix[codeword];
+    }
 }
 
 // -----------------------------------------------------------------------------
 // LZW-decompress from buffer to buffer.
-// The parameters "source_length" and "destination_length" are currently unused.
-// They might be used to prevent reading/writing outside the buffers.
+// Codewords are read LSB first through a 64-bit bit buffer.  Returns
+// EXIT_FAILURE if the data is corrupt or would overflow either buffer.
 // -----------------------------------------------------------------------------
 int U6Decode::lzw_decompress(unsigned char *source, long source_length, unsigned char *destination, long destination_length) {
     const int max_codeword_length = 12;
 
-    bool end_marker_reached = false;
+    const unsigned char* in = source;
+    const unsigned char* inEnd = source + source_length;
+    uint64_t bitBuf = 0;
+    int bitCount = 0;
+
     int codeword_size = 9;
-    long bits_read = 0; 
-    int next_free_codeword = 0x102;
+    int codeword_mask = 0x1ff;
+    int next_free_codeword = CODE_FIRST_FREE;
     int dictionary_size = 0x200;
 
     long bytes_written = 0;
+    int len;
 
     int cW;
     int pW = 0;
-    unsigned char C;
+    unsigned char C = 0;
 
-    while (! end_marker_reached) {
-        cW = get_next_codeword(bits_read, source, codeword_size);
+    Dict dict;
+    for (int i = 0; i < 0x100; ++i) {
+        dict.prefix[i] = 0;
+        dict.length[i] = 1;
+        dict.suffix[i] = dict.first[i] = (uint8_t) i;
+    }
+    // The control codes must never be referenced as a prefix.
+    dict.length[CODE_CLEAR] = dict.length[CODE_END] = 0;
+
+#define NEXT_CODEWORD(cw) \
+    if (bitCount < codeword_size) { \
+        while (bitCount <= 56 && in != inEnd) { \
+            bitBuf |= (uint64_t) *in++ << bitCount; \
+            bitCount += 8; \
+        } \
+        if (bitCount < codeword_size) \
+            return EXIT_FAILURE; \
+    } \
+    cw = (int) bitBuf & codeword_mask; \
+    bitBuf >>= codeword_size; \
+    bitCount -= codeword_size
+
+    for (;;) {
+        NEXT_CODEWORD(cW);
         switch (cW) {
             // re-init the dictionary
-        case 0x100:
+        case CODE_CLEAR:
             codeword_size = 9;
-            next_free_codeword = 0x102;
+            codeword_mask = 0x1ff;
+            next_free_codeword = CODE_FIRST_FREE;
             dictionary_size = 0x200;
-            dict.init();
-            cW = get_next_codeword(bits_read, source, codeword_size);
-            output_root((unsigned char)cW, destination, bytes_written);
+            NEXT_CODEWORD(cW);
+            if (cW > 0xff || bytes_written >= destination_length)
+                return EXIT_FAILURE;
+            destination[bytes_written++] = (unsigned char) cW;
             break;
             // end of compressed file has been reached
-        case 0x101:
-            end_marker_reached = true;
-            break;
-            // (cW <> 0x100) && (cW <> 0x101)
-        default:
-            if (cW < next_free_codeword) { // codeword is already in the dictionary
-                Stack stack;
+        case CODE_END:
+            return EXIT_SUCCESS;
 
-                // create the string associated with cW (on the stack)
-                get_string(stack, cW);
-                C = stack.gettop();
+        default:
+            if (cW < next_free_codeword) {
+                // codeword is already in the dictionary;
                 // output the string represented by cW
-                while (!stack.is_empty()) {
-                    output_root(stack.pop(), destination, bytes_written);
-                }
-                // add pW+C to the dictionary
-                dict.add(C,pW);
-
-                next_free_codeword++;
-                if (next_free_codeword >= dictionary_size) {
-                    if (codeword_size < max_codeword_length) {
-                        codeword_size += 1;
-                        dictionary_size *= 2;
-                    }
-                }
-            }
-            else {  // codeword is not yet defined
-                Stack stack;
-
-                // create the string associated with pW (on the stack)
-                get_string(stack, pW);
-                C = stack.gettop();
-                // output the string represented by pW
-                while (!stack.is_empty()) {
-                    output_root(stack.pop(), destination, bytes_written);
-                }
-                // output the char C
-                output_root(C, destination, bytes_written);
-                // the new dictionary entry must correspond to cW
-                // if it doesn't, something is wrong with the lzw-compressed data.
+                len = dict.length[cW];
+                if (bytes_written + len > destination_length)
+                    return EXIT_FAILURE;
+                write_string(dict, cW, destination + bytes_written);
+                C = dict.first[cW];
+            } else {
+                // codeword is not yet defined; the new dictionary entry must
+                // correspond to cW.  If it doesn't, something is wrong with
+                // the lzw-compressed data.
                 if (cW != next_free_codeword) {
                     printf("cW != next_free_codeword!\n");
-                    return(EXIT_FAILURE);
+                    return EXIT_FAILURE;
                 }
-                // add pW+C to the dictionary
-                dict.add(C,pW);
-             
-                next_free_codeword++;
-                if (next_free_codeword >= dictionary_size) {
-                    if (codeword_size < max_codeword_length) {
-                        codeword_size += 1;
-                        dictionary_size *= 2;
-                    } 
+                // output the string represented by pW followed by C
+                len = dict.length[pW] + 1;
+                if (bytes_written + len > destination_length)
+                    return EXIT_FAILURE;
+                C = dict.first[pW];
+                write_string(dict, pW, destination + bytes_written);
+                destination[bytes_written + len - 1] = C;
+            }
+            bytes_written += len;
+
+            // add pW+C to the dictionary
+            if (next_free_codeword < DICT_SIZE) {
+                dict.prefix[next_free_codeword] = pW;
+                dict.suffix[next_free_codeword] = C;
+                dict.first [next_free_codeword] = dict.first[pW];
+                dict.length[next_free_codeword] = dict.length[pW] + 1;
+            }
+            next_free_codeword++;
+            if (next_free_codeword >= dictionary_size) {
+                if (codeword_size < max_codeword_length) {
+                    codeword_size += 1;
+                    codeword_mask = (codeword_mask << 1) | 1;
+                    dictionary_size *= 2;
                 }
             }
             break;
@@ -246,8 +236,7 @@ int U6Decode::lzw_decompress(unsigned char *source, long source_length, unsigned
         // shift roles - the current cW becomes the new pW
         pW = cW;
     }
-
-    return(EXIT_SUCCESS);
+#undef NEXT_CODEWORD
 }
 
 // -----------------
@@ -9,6 +9,7 @@
 #include "event.h"
 #include "party.h"
 #include "portal.h"
+#include "telemetry.h"
 #include "tileset.h"
 #include "xu4.h"
 
@@ -320,68 +321,124 @@ buffer_full:
 }
 
 /*
- * Call a function for each entity (Annotations & Objects) near a coordinate.
+ * Return the offset of the first repeat of d (on an axis which wraps every
+ * dim units) which is not less than -radius.
+ */
+static inline int wrapFirst(int d, int radius, int dim) {
+    d = (d + radius) % dim;
+    if (d < 0)
+        d += dim;
+    return d - radius;
+}
+
+/*
+ * Append a sprite for each place pos is seen within the square area around
+ * center.  A wrapping map smaller than the area (such as a dungeon level
+ * repeated by the GPU renderer) shows an entity more than once.
+ *
+ * Return the new end of the sprites array.
+ */
+static VisibleSprite* emitVisible(VisibleSprite* sp, const Map* map,
+                                  const Coords* pos, const Coords& center,
+                                  int radius, VisualId vid) {
+    unsigned int span = radius * 2;
+    int dx, dy, x, y, stepX, stepY;
+
+    if (map->levels > 1 && pos->z != center.z)
+        return sp;
+
+    dx = pos->x - center.x;
+    dy = pos->y - center.y;
+    if (map->border_behavior == Map::BORDER_WRAP) {
+        dx = wrapFirst(dx, radius, map->width);
+        dy = wrapFirst(dy, radius, map->height);
+        stepX = map->width;
+        stepY = map->height;
+    } else {
+        // Unsigned compare tests both sides of the area at once.
+        if (unsigned(dx + radius) > span || unsigned(dy + radius) > span)
+            return sp;
+        stepX = stepY = span + 1;
+    }
+
+    for (y = dy; y <= radius; y += stepY) {
+        for (x = dx; x <= radius; x += stepX) {
+            sp->x = center.x + x;
+            sp->y = center.y + y;
+            sp->vid = vid;
+            ++sp;
+        }
+    }
+    return sp;
+}
+
+/*
+ * Return the size of the sprites array needed by queryVisible().
+ */
+int Map::queryVisibleLimit(int radius) const {
+    int repeat = 1;
+    if (border_behavior == BORDER_WRAP) {
+        int span = radius * 2 + 1;
+        repeat = ((span + width - 1) / width) *
+                 ((span + height - 1) / height);
+    }
+    return (annotations.size() + objects.size() + 1) * repeat;
+}
+
+/*
+ * Fill an array with the position & visual of each entity (Annotations,
+ * Objects & the avatar) near a coordinate.
+ *
+ * On wrapping maps the entity positions are relative to the center (rather
+ * than the actual map coordinates) so they are always adjacent to it, and
+ * an entity is included once for each repeat of the map in the area.
+ * On maps with more than one level only entities on the center level are
+ * included.
  *
  * \param center    Center of area to process.
  * \param radius    Number of tiles away from center.
- * \param func      Callback function.
- * \param user      User data pointer passed to callback.
+ * \param sprites   Array to fill.  This must hold at least
+ *                  queryVisibleLimit(radius) entries.
+ * \param focusPtr  Set to the focused object in the area or NULL.
+ *
+ * \return Number of entries written to sprites.
  */
-void Map::queryVisible(const Coords& center, int radius,
-                       void (*func)(const Coords*, VisualId, void*),
-                       void* user, const Object** focusPtr) const {
-    int minX, minY, maxX, maxY;
-    const Coords* cp;
+int Map::queryVisible(const Coords& center, int radius,
+                      VisibleSprite* sprites, const Object** focusPtr) const {
+    VisibleSprite* sp = sprites;
+    VisibleSprite* prev;
     const TileRenderData* rd = tileset->render;
-    VisualId vid;
 
     *focusPtr = NULL;
 
-#define OUTSIDE(C) (C->x < minX || C->x > maxX || C->y < minY || C->y > maxY)
-
-    minX = center.x - radius;
-    minY = center.y - radius;
-    maxX = center.x + radius;
-    maxY = center.y + radius;
+#define EMIT(C,V)   sp = emitVisible(sp, this, C, center, radius, V)
 
     AnnotationList::const_iterator ait;
     for(ait = annotations.begin(); ait != annotations.end(); ait++) {
         const Annotation& ann = *ait;
-        cp = &ann.coords;
-        if (OUTSIDE(cp))
-            continue;
-        //printf("KR ann %d %d %d,%d\n",
-        //        ann.tile.id, ann.tile.frame, cp->x, cp->y);
-        vid = rd[ann.tile.id].vid;
-        func(cp, vid, user);
+        EMIT(&ann.coords, rd[ann.tile.id].vid);
     }
 
     const Animator* animator = &xu4.eventHandler->flourishAnim;
-    ObjectDeque::const_iterator it;
+    ObjectVector::const_iterator it;
     for(it = objects.begin(); it != objects.end(); it++) {
         Object* obj = *it;
-        cp = &obj->coords;
-        if (OUTSIDE(cp))
-            continue;
-        if (obj->focused)
-            *focusPtr = obj;
-        //printf("KR obj %d %d %d,%d\n",
-        //        obj->tile.id, obj->tile.frame, cp->x, cp->y);
         if (obj->animId != ANIM_UNUSED) {
             obj->tile.frame = anim_valueI(animator, obj->animId);
         }
-        vid = rd[obj->tile.id].vid + obj->tile.frame;
-        func(cp, vid, user);
+        prev = sp;
+        EMIT(&obj->coords, rd[obj->tile.id].vid + obj->tile.frame);
+        if (obj->focused && sp != prev)
+            *focusPtr = obj;
     }
 
-    if (flags & SHOW_AVATAR) {
-        cp = &c->location->coords;
-        if (! OUTSIDE(cp)) {
-            MapTile trans = c->party->getTransport();
-            vid = rd[trans.id].vid + trans.frame;
-            func(cp, vid, user);
-        }
+    // The avatar is always shown in the top-down dungeon view.
+    if ((flags & SHOW_AVATAR) || type == DUNGEON) {
+        MapTile trans = c->party->getTransport();
+        EMIT(&c->location->coords, rd[trans.id].vid + trans.frame);
     }
+
+    return sp - sprites;
 }
 
 /*
@@ -407,7 +464,7 @@ void Map::queryAnnotations(const Coords& pos,
  */
 const Object *Map::objectAt(const Coords &coords) const {
     /* FIXME: return a list instead of one object */
-    ObjectDeque::const_iterator i;
+    ObjectVector::const_iterator i;
     const Object *objAt = NULL;
 
     for(i = objects.begin(); i != objects.end(); i++) {
@@ -605,11 +662,11 @@ Object *Map::addObject(MapTile tile, MapTile prevtile, const Coords& coords) {
  */
 
 // This function should only be used when not iterating through an
-// ObjectDeque, as the iterator will be invalidated and the
+// ObjectVector, as the iterator will be invalidated and the
 // results will be unpredictable.  Instead, use the function
 // below.
 bool Map::removeObject(const Object *rem, bool deleteObject) {
-    ObjectDeque::iterator i;
+    ObjectVector::iterator i;
     for (i = objects.begin(); i != objects.end(); i++) {
         if (*i == rem) {
             /* Party members persist through different maps, so don't delete them! */
@@ -622,7 +679,7 @@ bool Map::removeObject(const Object *rem, bool deleteObject) {
     return false;
 }
 
-ObjectDeque::iterator Map::removeObject(ObjectDeque::iterator rem, bool deleteObject) {
+ObjectVector::iterator Map::removeObject(ObjectVector::iterator rem, bool deleteObject) {
     /* Party members persist through different maps, so don't delete them! */
     if (!isPartyMember(*rem) && deleteObject)
         delete (*rem);
@@ -643,6 +700,7 @@ bool Map::objectPresent(const Object* obj) const {
  */
 Creature *Map::moveObjects(const Coords& avatar) {
     Creature *attacker = NULL;
+    TELE_SCOPE(TZ_MOVE_OBJECTS);
 
     for (unsigned int i = 0; i < objects.size(); i++) {
         Creature *m = dynamic_cast<Creature*>(objects[i]);
@@ -689,7 +747,7 @@ Creature *Map::moveObjects(const Coords& avatar) {
  * Removes all objects from the given map
  */
 void Map::clearObjects() {
-    for (ObjectDeque::iterator o = objects.begin(); o != objects.end(); o++) {
+    for (ObjectVector::iterator o = objects.begin(); o != objects.end(); o++) {
         if (! isPartyMember(*o))
             delete *o;
     }
@@ -700,7 +758,7 @@ void Map::clearObjects() {
  * Returns the number of creatures on the given map
  */
 int Map::getNumberOfCreatures() {
-    ObjectDeque::const_iterator i;
+    ObjectVector::const_iterator i;
     int n = 0;
 
     for (i = objects.begin(); i != objects.end(); i++) {
@@ -878,7 +936,7 @@ bool Map::move(Object *obj, Direction d) {
  * Alerts the guards that the avatar is doing something bad
  */
 void Map::alertGuards() {
-    ObjectDeque::iterator i;
+    ObjectVector::iterator i;
     const Creature *m;
 
     /* switch all the guards to attack mode */
@@ -923,7 +981,7 @@ void Map::putInBounds(Coords& c) const {
 }
 
 void Map::fillMonsterTable(SaveGameMonsterRecord* table) const {
-    ObjectDeque::const_iterator current;
+    ObjectVector::const_iterator current;
     const Object *obj;
     CObjectDeque monsters;
     CObjectDeque other_creatures;
@@ -1013,7 +1071,7 @@ void Map::fillMonsterTable(SaveGameMonsterRecord* table) const {
 
 void Map::fillMonsterTableDungeon(SaveGameMonsterRecord* table) const {
     MapTile prevTile;
-    ObjectDeque::const_iterator it;
+    ObjectVector::const_iterator it;
     SaveGameMonsterRecord* end = table + MONSTERTABLE_SIZE;
     const UltimaSaveIds* saveIds = xu4.config->usaveIds();
     const Object *obj;
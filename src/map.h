@@ -21,7 +21,7 @@ class Tileset;
 struct Portal;
 
 typedef std::vector<Portal *> PortalList;
-typedef std::deque<Object *> ObjectDeque;
+typedef std::vector<Object *> ObjectVector;
 typedef std::deque<const Object *> CObjectDeque;
 
 /* flags */
@@ -34,6 +34,13 @@ typedef std::deque<const Object *> CObjectDeque;
 #define WITH_GROUND_OBJECTS 1
 #define WITH_OBJECTS        2
 
+// Entry filled by Map::queryVisible.
+struct VisibleSprite {
+    int16_t x, y;           // Map coordinates.
+    VisualId vid;
+    uint16_t _pad;
+};
+
 #define BLOCKING_POS_SIZE   128*3
 struct BlockingGroups {
     int left, center, right;
@@ -71,9 +78,9 @@ public:
     virtual const char* getName() const;
 
     void queryBlocking(BlockingGroups*, int sx, int sy, int vw, int vh) const;
-    void queryVisible(const Coords &coords, int radius,
-                      void (*func)(const Coords*, VisualId, void*),
-                      void* user, const Object** focus) const;
+    int  queryVisibleLimit(int radius) const;
+    int  queryVisible(const Coords &coords, int radius,
+                      VisibleSprite* sprites, const Object** focus) const;
     void queryAnnotations(const Coords& pos,
                           int (*func)(const Annotation*, void*),
                           void* user) const;
@@ -91,7 +98,7 @@ public:
     class Object *addObject(MapTile tile, MapTile prevTile, const Coords& coords);
     class Object *addObject(Object *obj, Coords coords);
     bool removeObject(const class Object *rem, bool deleteObject = true);
-    ObjectDeque::iterator removeObject(ObjectDeque::iterator rem, bool deleteObject = true);
+    ObjectVector::iterator removeObject(ObjectVector::iterator rem, bool deleteObject = true);
     void clearObjects();
     bool objectPresent(const Object* obj) const;
     class Creature *moveObjects(const Coords& avatar);
@@ -128,7 +135,7 @@ public:
     PortalList      portals;
     AnnotationList  annotations;
     TileId*         data;
-    ObjectDeque     objects;
+    ObjectVector    objects;
     std::map<Symbol, Coords> labels;
     const Tileset*  tileset;
 
@@ -13,6 +13,57 @@
 
 extern bool isPartyMember(const Object*);
 
+#define POOL_ALIGN      16
+#define POOL_CLASSES    16      // Pooled sizes are up to 256 bytes.
+#define POOL_SLAB_COUNT 64      // Objects allocated together per refill.
+
+struct PoolNode {
+    PoolNode* next;
+};
+
+/*
+ * Free lists for each size class.  Maps, towns & combat create and destroy
+ * many objects so these are recycled rather than going through the general
+ * heap each time.  Slabs are never released, so a node freed on a thread
+ * other than the one that allocated it is still valid.
+ */
+static thread_local PoolNode* poolFree[POOL_CLASSES];
+
+void* Object::operator new(size_t size) {
+    size_t sc = (size + POOL_ALIGN - 1) / POOL_ALIGN;
+    if (sc > POOL_CLASSES)
+        return ::operator new(size);
+
+    PoolNode*& head = poolFree[sc - 1];
+    if (! head) {
+        size_t stride = sc * POOL_ALIGN;
+        uint8_t* slab = (uint8_t*) ::operator new(stride * POOL_SLAB_COUNT);
+        for (int i = POOL_SLAB_COUNT - 1; i >= 0; --i) {
+            PoolNode* node = (PoolNode*) (slab + i * stride);
+            node->next = head;
+            head = node;
+        }
+    }
+
+    PoolNode* node = head;
+    head = node->next;
+    return node;
+}
+
+void Object::operator delete(void* ptr, size_t size) {
+    size_t sc = (size + POOL_ALIGN - 1) / POOL_ALIGN;
+    if (! ptr)
+        return;
+    if (sc > POOL_CLASSES) {
+        ::operator delete(ptr);
+        return;
+    }
+
+    PoolNode* node = (PoolNode*) ptr;
+    node->next = poolFree[sc - 1];
+    poolFree[sc - 1] = node;
+}
+
 Object::Object(Type type) :
   tile(0),
   prevTile(0),
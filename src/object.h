@@ -5,6 +5,7 @@
 #ifndef OBJECT_H
 #define OBJECT_H
 
+#include <cstddef>
 #include "anim.h"
 #include "coords.h"
 #include "tile.h"
@@ -30,6 +31,11 @@ public:
     Object(Type type = UNKNOWN);
     virtual ~Object();
 
+    // Objects of all types are allocated from size class pools.
+    static void* operator new(size_t size);
+    static void* operator new(size_t, void* place) { return place; }
+    static void  operator delete(void* ptr, size_t size);
+
     // Methods
     void setTile(const Tile *t) { tile = t->getId(); }
 
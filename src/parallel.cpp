@@ -0,0 +1,74 @@
+/*
+ * parallel.cpp
+ */
+
+#include <atomic>
+#include <thread>
+
+#include "parallel.h"
+
+#define MAX_WORKERS 16
+
+struct ParallelJob {
+    ParallelFunc func;
+    void* user;
+    int count;
+    std::atomic<int> next;
+};
+
+static void parallel_worker(ParallelJob* job) {
+    int i;
+    while ((i = job->next.fetch_add(1)) < job->count)
+        job->func(job->user, i);
+}
+
+static int parallel_detectThreads() {
+    int n = (int) std::thread::hardware_concurrency();
+    if (n < 1)
+        return 1;
+    return (n > MAX_WORKERS) ? MAX_WORKERS : n;
+}
+
+/**
+ * Return the number of threads parallel_for() will use for large jobs.
+ */
+int parallel_threadCount() {
+    static const int count = parallel_detectThreads();
+    return count;
+}
+
+/**
+ * Call func for each index from 0 to count-1, spreading the calls over all
+ * available cores.  The calling thread does a share of the work and this
+ * function returns once every call has completed.
+ *
+ * The order of the calls is undefined, so func must only touch data
+ * belonging to its index (or data that is read-only for the duration).
+ */
+void parallel_for(int count, ParallelFunc func, void* user) {
+    std::thread workers[MAX_WORKERS];
+    ParallelJob job;
+    int i, wcount;
+
+    wcount = parallel_threadCount();
+    if (wcount > count)
+        wcount = count;
+    --wcount;               // The caller is one of the threads.
+
+    if (wcount < 1) {
+        for (i = 0; i < count; ++i)
+            func(user, i);
+        return;
+    }
+
+    job.func  = func;
+    job.user  = user;
+    job.count = count;
+    job.next  = 0;
+
+    for (i = 0; i < wcount; ++i)
+        workers[i] = std::thread(parallel_worker, &job);
+    parallel_worker(&job);
+    for (i = 0; i < wcount; ++i)
+        workers[i].join();
+}
@@ -0,0 +1,13 @@
+/*
+ * parallel.h
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+typedef void (*ParallelFunc)(void* user, int index);
+
+int  parallel_threadCount();
+void parallel_for(int count, ParallelFunc func, void* user);
+
+#endif /* PARALLEL_H */
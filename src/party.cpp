@@ -377,13 +377,12 @@ EquipError PartyMember::setWeapon(const Weapon *w) {
  * keeps interface consistent for virtual base function Creature::applydamage()
  */
 bool PartyMember::applyDamage(Map* map, int damage, bool) {
-    int newHp = player->hp;
+    int newHp;
 
     if (isDead())
         return false;
 
-    newHp -= damage;
-
+    newHp = playerDamageHp(player->hp, damage);
     if (newHp < 0) {
         setStatus(STAT_DEAD);
         newHp = 0;
@@ -438,14 +437,8 @@ bool PartyMember::dealDamage(Map* map, Creature *m, int damage) {
  * Calculate damage for an attack.
  */
 int PartyMember::getDamage() {
-    int maxDamage;
-
-    maxDamage = xu4.config->weapon(player->weapon)->damage;
-    maxDamage += player->str;
-    if (maxDamage > 255)
-        maxDamage = 255;
-
-    return xu4_random(maxDamage);
+    int weaponDamage = xu4.config->weapon(player->weapon)->damage;
+    return playerRollDamage(xu4.randomSim, weaponDamage, player->str);
 }
 
 /**
@@ -536,6 +529,12 @@ Party::~Party() {
  * Notify the party that something about it has changed
  */
 void Party::notifyOfChange(PartyMember *pm, PartyEvent::Type eventType) {
+    // Generic changes only prompt redraws so they are coalesced until the
+    // next screen update.
+    if (eventType == PartyEvent::GENERIC) {
+        gs_postMessage(SENDER_PARTY);
+        return;
+    }
     PartyEvent event(eventType, pm);
     gs_emitMessage(SENDER_PARTY, &event);
 }
@@ -1150,6 +1149,31 @@ void Party::syncMembers() {
     }
 }
 
+/**
+ * Get the party state which is not stored in the SaveGame.
+ */
+void Party::getState(PartyState* ps) const {
+    ps->transport     = transport;
+    ps->torchduration = torchduration;
+    ps->activePlayer  = activePlayer;
+}
+
+/**
+ * Restore the party state after the SaveGame has been replaced.
+ * The members are recreated from the SaveGame player records.
+ * No notifications are emitted.
+ */
+void Party::restoreState(const PartyState* ps) {
+    PartyMemberVector::iterator it;
+    foreach (it, members)
+        delete *it;
+    syncMembers();
+
+    torchduration = ps->torchduration;
+    activePlayer  = ps->activePlayer;
+    initTransport(ps->transport);
+}
+
 /**
  * Returns the size of the party
  */
@@ -161,6 +161,13 @@ public:
 
 typedef std::vector<PartyMember *> PartyMemberVector;
 
+// Party data not held in the SaveGame.
+struct PartyState {
+    MapTile transport;
+    int torchduration;
+    int activePlayer;
+};
+
 class Party {
     friend class PartyMember;
 public:
@@ -211,6 +218,9 @@ public:
     int size() const;
     PartyMember *member(int index) const;
 
+    void getState(PartyState*) const;
+    void restoreState(const PartyState*);
+
 private:
     void initTransport(const MapTile& tile);
     void syncMembers();
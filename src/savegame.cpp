@@ -4,29 +4,22 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include "savegame.h"
 
 
-static int writeInt(uint32_t i, FILE *f) {
-    if (fputc(i & 0xff, f) == EOF ||
-        fputc((i >> 8) & 0xff, f) == EOF ||
-        fputc((i >> 16) & 0xff, f) == EOF ||
-        fputc((i >> 24) & 0xff, f) == EOF)
-        return 0;
-    return 1;
-}
-
-static int writeShort(uint16_t s, FILE *f) {
-    if (fputc(s & 0xff, f) == EOF ||
-        fputc((s >> 8) & 0xff, f) == EOF)
-        return 0;
-    return 1;
+static inline uint8_t* packInt(uint8_t* p, uint32_t i) {
+    p[0] = i & 0xff;
+    p[1] = (i >> 8) & 0xff;
+    p[2] = (i >> 16) & 0xff;
+    p[3] = (i >> 24) & 0xff;
+    return p + 4;
 }
 
-static int writeChar(uint8_t c, FILE *f) {
-    if (fputc(c, f) == EOF)
-        return 0;
-    return 1;
+static inline uint8_t* packShort(uint8_t* p, uint16_t s) {
+    p[0] = s & 0xff;
+    p[1] = (s >> 8) & 0xff;
+    return p + 2;
 }
 
 static int readInt(uint32_t *i, FILE *f) {
@@ -49,77 +42,69 @@ static int readChar(uint8_t *c, FILE *f) {
 }
 
 
-int SaveGame::write(FILE *f) const {
+/*
+ * Store the game in party.sav format (SAVEGAME_PACKED_SIZE bytes).
+ * Return a pointer to the end of the packed data.
+ */
+uint8_t* SaveGame::pack(uint8_t* p) const {
     int i;
 
-    if (!writeInt(unknown1, f) ||
-        !writeInt(moves, f))
-        return 0;
-
-    for (i = 0; i < 8; i++) {
-        if (!players[i].write(f))
-            return 0;
-    }
-
-    if (!writeInt(food, f) ||
-        !writeShort(gold, f))
-        return 0;
-
-    for (i = 0; i < 8; i++) {
-        if (!writeShort(karma[i], f))
-            return 0;
-    }
-
-    if (!writeShort(torches, f) ||
-        !writeShort(gems, f) ||
-        !writeShort(keys, f) ||
-        !writeShort(sextants, f))
-        return 0;
+    p = packInt(p, unknown1);
+    p = packInt(p, moves);
 
-    for (i = 0; i < ARMR_MAX; i++) {
-        if (!writeShort(armor[i], f))
-            return 0;
-    }
+    for (i = 0; i < 8; i++)
+        p = players[i].pack(p);
 
-    for (i = 0; i < WEAP_MAX; i++) {
-        if (!writeShort(weapons[i], f))
-            return 0;
-    }
+    p = packInt(p, food);
+    p = packShort(p, gold);
 
-    for (i = 0; i < REAG_MAX; i++) {
-        if (!writeShort(reagents[i], f))
-            return 0;
-    }
+    for (i = 0; i < 8; i++)
+        p = packShort(p, karma[i]);
 
-    for (i = 0; i < SPELL_MAX; i++) {
-        if (!writeShort(mixtures[i], f))
-            return 0;
-    }
+    p = packShort(p, torches);
+    p = packShort(p, gems);
+    p = packShort(p, keys);
+    p = packShort(p, sextants);
 
-    if (!writeShort(items, f) ||
-        !writeChar(x, f) ||
-        !writeChar(y, f) ||
-        !writeChar(stones, f) ||
-        !writeChar(runes, f) ||
-        !writeShort(members, f) ||
-        !writeShort(transport, f) ||
-        !writeShort(balloonstate, f) ||
-        !writeShort(trammelphase, f) ||
-        !writeShort(feluccaphase, f) ||
-        !writeShort(shiphull, f) ||
-        !writeShort(lbintro, f) ||
-        !writeShort(lastcamp, f) ||
-        !writeShort(lastreagent, f) ||
-        !writeShort(lastmeditation, f) ||
-        !writeShort(lastvirtue, f) ||
-        !writeChar(dngx, f) ||
-        !writeChar(dngy, f) ||
-        !writeShort(orientation, f) ||
-        !writeShort(dnglevel, f) ||
-        !writeShort(location, f))
-        return 0;
+    for (i = 0; i < ARMR_MAX; i++)
+        p = packShort(p, armor[i]);
+    for (i = 0; i < WEAP_MAX; i++)
+        p = packShort(p, weapons[i]);
+    for (i = 0; i < REAG_MAX; i++)
+        p = packShort(p, reagents[i]);
+    for (i = 0; i < SPELL_MAX; i++)
+        p = packShort(p, mixtures[i]);
+
+    p = packShort(p, items);
+    *p++ = x;
+    *p++ = y;
+    *p++ = stones;
+    *p++ = runes;
+    p = packShort(p, members);
+    p = packShort(p, transport);
+    p = packShort(p, balloonstate);
+    p = packShort(p, trammelphase);
+    p = packShort(p, feluccaphase);
+    p = packShort(p, shiphull);
+    p = packShort(p, lbintro);
+    p = packShort(p, lastcamp);
+    p = packShort(p, lastreagent);
+    p = packShort(p, lastmeditation);
+    p = packShort(p, lastvirtue);
+    *p++ = dngx;
+    *p++ = dngy;
+    p = packShort(p, orientation);
+    p = packShort(p, dnglevel);
+    p = packShort(p, location);
+    return p;
+}
 
-    return 1;
+int SaveGame::write(FILE *f) const {
+    uint8_t buf[SAVEGAME_PACKED_SIZE];
+    const uint8_t* end = pack(buf);
+    assert(end == buf + SAVEGAME_PACKED_SIZE);
+    (void) end;
+    return fwrite(buf, 1, SAVEGAME_PACKED_SIZE, f) == SAVEGAME_PACKED_SIZE;
 }
 
 int SaveGame::read(FILE *f) {
@@ -255,32 +240,27 @@ void SaveGame::init(const SaveGamePlayerRecord *avatarInfo) {
     location = 0;
 }
 
-int SaveGamePlayerRecord::write(FILE *f) const {
+uint8_t* SaveGamePlayerRecord::pack(uint8_t* p) const {
     int i;
 
-    if (!writeShort(hp, f) ||
-        !writeShort(hpMax, f) ||
-        !writeShort(xp, f) ||
-        !writeShort(str, f) ||
-        !writeShort(dex, f) ||
-        !writeShort(intel, f) ||
-        !writeShort(mp, f) ||
-        !writeShort(unknown, f) ||
-        !writeShort((unsigned short)weapon, f) ||
-        !writeShort((unsigned short)armor, f))
-        return 0;
-
-    for (i = 0; i < 16; i++) {
-        if (!writeChar(name[i], f))
-            return 0;
-    }
+    p = packShort(p, hp);
+    p = packShort(p, hpMax);
+    p = packShort(p, xp);
+    p = packShort(p, str);
+    p = packShort(p, dex);
+    p = packShort(p, intel);
+    p = packShort(p, mp);
+    p = packShort(p, unknown);
+    p = packShort(p, (unsigned short) weapon);
+    p = packShort(p, (unsigned short) armor);
 
-    if (!writeChar((unsigned char)sex, f) ||
-        !writeChar((unsigned char)klass, f) ||
-        !writeChar((unsigned char)status, f))
-        return 0;
+    for (i = 0; i < 16; i++)
+        *p++ = name[i];
 
-    return 1;
+    *p++ = (unsigned char) sex;
+    *p++ = (unsigned char) klass;
+    *p++ = (unsigned char) status;
+    return p;
 }
 
 int SaveGamePlayerRecord::read(FILE *f) {
@@ -345,33 +325,43 @@ void SaveGamePlayerRecord::init() {
     status = STAT_GOOD;
 }
 
-int saveGameMonstersWrite(const SaveGameMonsterRecord *monsterTable, FILE *f) {
-    int i, max;
+/*
+ * Store the monster table in monsters.sav format (MONSTERS_PACKED_SIZE
+ * bytes).  If monsterTable is NULL then an empty table is stored.
+ * Return a pointer to the end of the packed data.
+ */
+uint8_t* saveGameMonstersPack(const SaveGameMonsterRecord *monsterTable,
+                              uint8_t* p) {
+    int i;
 
     if (monsterTable) {
         for (i = 0; i < MONSTERTABLE_SIZE; i++)
-            if (!writeChar(monsterTable[i].tile, f)) return 0;
+            *p++ = monsterTable[i].tile;
         for (i = 0; i < MONSTERTABLE_SIZE; i++)
-            if (!writeChar(monsterTable[i].x, f)) return 0;
+            *p++ = monsterTable[i].x;
         for (i = 0; i < MONSTERTABLE_SIZE; i++)
-            if (!writeChar(monsterTable[i].y, f)) return 0;
+            *p++ = monsterTable[i].y;
         for (i = 0; i < MONSTERTABLE_SIZE; i++)
-            if (!writeChar(monsterTable[i].prevTile, f)) return 0;
+            *p++ = monsterTable[i].prevTile;
         for (i = 0; i < MONSTERTABLE_SIZE; i++)
-            if (!writeChar(monsterTable[i].prevx, f)) return 0;
+            *p++ = monsterTable[i].prevx;
         for (i = 0; i < MONSTERTABLE_SIZE; i++)
-            if (!writeChar(monsterTable[i].prevy, f)) return 0;
+            *p++ = monsterTable[i].prevy;
         for (i = 0; i < MONSTERTABLE_SIZE; i++)
-            if (!writeChar(monsterTable[i].level, f)) return 0;
+            *p++ = monsterTable[i].level;
         for (i = 0; i < MONSTERTABLE_SIZE; i++)
-            if (!writeChar(monsterTable[i].unused, f)) return 0;
-    }
-    else {
-        max = MONSTERTABLE_SIZE * 8;
-        for (i = 0; i < max; i++)
-            if (!writeChar((unsigned char)0, f)) return 0;
+            *p++ = monsterTable[i].unused;
+    } else {
+        memset(p, 0, MONSTERS_PACKED_SIZE);
+        p += MONSTERS_PACKED_SIZE;
     }
-    return 1;
+    return p;
+}
+
+int saveGameMonstersWrite(const SaveGameMonsterRecord *monsterTable, FILE *f) {
+    uint8_t buf[MONSTERS_PACKED_SIZE];
+    saveGameMonstersPack(monsterTable, buf);
+    return fwrite(buf, 1, MONSTERS_PACKED_SIZE, f) == MONSTERS_PACKED_SIZE;
 }
 
 int saveGameMonstersRead(SaveGameMonsterRecord *monsterTable, FILE *f) {
@@ -398,6 +388,7 @@ int saveGameMonstersRead(SaveGameMonsterRecord *monsterTable, FILE *f) {
 }
 
 #ifndef SAVE_UTIL
+#include "savewriter.h"
 #include "settings.h"
 #include "xu4.h"
 
@@ -407,7 +398,10 @@ int saveGameMonstersRead(SaveGameMonsterRecord *monsterTable, FILE *f) {
  */
 SaveGame* saveGameLoad() {
     SaveGame* sg = NULL;
-    FILE* fp = fopen((xu4.settings->getUserPath() + PARTY_SAV).c_str(), "rb");
+    FILE* fp;
+    savewriter_wait();
+    savewriter_recover(xu4.settings->getUserPath().c_str());
+    fp = fopen((xu4.settings->getUserPath() + PARTY_SAV).c_str(), "rb");
     if (fp) {
         sg = new SaveGame;
         sg->read(fp);
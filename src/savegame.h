@@ -17,6 +17,9 @@
 #define MONSTERTABLE_CREATURES_SIZE     8
 #define MONSTERTABLE_OBJECTS_SIZE       (MONSTERTABLE_SIZE - MONSTERTABLE_CREATURES_SIZE)
 
+#define SAVEGAME_PACKED_SIZE    502     // Bytes in party.sav
+#define MONSTERS_PACKED_SIZE    (MONSTERTABLE_SIZE * 8)
+
 /**
  * The list of all weapons.  These values are used in both the
  * inventory fields and character records of the savegame.
@@ -166,7 +169,7 @@ enum Rune {
  * The Ultima IV savegame player record data.
  */
 struct SaveGamePlayerRecord {
-    int write(FILE *f) const;
+    uint8_t* pack(uint8_t* p) const;
     int read(FILE *f);
     void init();
 
@@ -202,6 +205,7 @@ typedef struct _SaveGameMonsterRecord {
  * Represents the on-disk contents of PARTY.SAV.
  */
 struct SaveGame {
+    uint8_t* pack(uint8_t* p) const;
     int write(FILE *f) const;
     int read(FILE *f);
     void init(const SaveGamePlayerRecord *avatarInfo);
@@ -244,6 +248,8 @@ struct SaveGame {
     uint16_t location;
 };
 
+uint8_t* saveGameMonstersPack(const SaveGameMonsterRecord *monsterTable,
+                              uint8_t* p);
 int saveGameMonstersWrite(const SaveGameMonsterRecord *monsterTable, FILE *f);
 int saveGameMonstersRead(SaveGameMonsterRecord *monsterTable, FILE *f);
 SaveGame* saveGameLoad();
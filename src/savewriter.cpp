@@ -0,0 +1,411 @@
+/*
+ * savewriter.cpp
+ *
+ * Writes save game files on a background thread.  The game thread packs
+ * the data into memory and submits it as a job; the writer thread puts each
+ * file into a temporary file and then renames them over the old files.
+ *
+ * The files of a job are replaced as a set.  Once all the temporary files
+ * are written a commit file listing them is renamed into place; this single
+ * rename is the point at which the new set becomes the save.  If the game
+ * stops before then the old files are untouched, and if it stops while
+ * the files are being renamed savewriter_recover() finishes the job.
+ */
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "error.h"
+#include "savewriter.h"
+#include "settings.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define COMMIT_FILE     "save.commit"
+
+struct SaveFile {
+    std::string name;
+    std::vector<uint8_t> data;
+};
+
+struct SaveJob {
+    std::string dir;
+    std::vector<SaveFile> files;
+    int sync;
+    SaveJob* next;
+};
+
+static struct {
+    std::mutex mutex;
+    std::condition_variable wake;       // Signals the writer thread.
+    std::condition_variable done;       // Signals savewriter_wait().
+    std::thread thread;
+    SaveJob* head;
+    SaveJob* tail;
+    bool busy;
+    bool quit;
+    int failures;       // Failed jobs since the last savewriter_wait().
+    int unreported;     // Failed jobs since the last savewriter_failures().
+} sw;
+
+static bool syncFile(FILE* fp) {
+    if (fflush(fp) != 0)
+        return false;
+#ifdef _WIN32
+    return _commit(_fileno(fp)) == 0;
+#else
+    return fsync(fileno(fp)) == 0;
+#endif
+}
+
+static bool replaceFile(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING |
+                                 MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+static bool fileExists(const char* path) {
+#ifdef _WIN32
+    return _access(path, 0) == 0;
+#else
+    return access(path, F_OK) == 0;
+#endif
+}
+
+#ifndef _WIN32
+// Make the renames durable.
+static void syncDir(const char* dir) {
+    int fd = open(dir[0] ? dir : ".", O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+#endif
+
+/*
+ * Rename the temporary files listed in the commit file of dir over the old
+ * files, then remove the commit file.  Files which have no temporary file
+ * were already renamed.
+ *
+ * Return false if the commit file exists but could not be completed.
+ */
+static bool finishCommit(const std::string& dir, bool sync) {
+    std::string commit(dir + COMMIT_FILE);
+    std::string path, tmp;
+    char name[64];
+    size_t len;
+    FILE* fp;
+    bool ok = true;
+
+    fp = fopen(commit.c_str(), "r");
+    if (! fp)
+        return true;
+
+    while (fgets(name, sizeof(name), fp)) {
+        len = strlen(name);
+        if (len && name[len-1] == '\n')
+            name[--len] = '\0';
+        if (! len)
+            continue;
+        path = dir + name;
+        tmp  = path + ".tmp";
+        if (fileExists(tmp.c_str()) &&
+            ! replaceFile(tmp.c_str(), path.c_str())) {
+            errorWarning("Cannot replace save file %s", path.c_str());
+            ok = false;
+        }
+    }
+    fclose(fp);
+
+    if (ok) {
+#ifndef _WIN32
+        if (sync)
+            syncDir(dir.c_str());
+#endif
+        remove(commit.c_str());
+    }
+    return ok;
+}
+
+/*
+ * Write the list of job files to the commit file.  Renaming it into place
+ * commits the job.
+ */
+static bool writeCommit(const SaveJob* job) {
+    std::string commit(job->dir + COMMIT_FILE);
+    std::string tmp(commit + ".tmp");
+    FILE* fp;
+    size_t i;
+    bool ok;
+
+    fp = fopen(tmp.c_str(), "w");
+    if (! fp)
+        return false;
+    ok = true;
+    for (i = 0; i < job->files.size(); ++i) {
+        if (fprintf(fp, "%s\n", job->files[i].name.c_str()) < 0)
+            ok = false;
+    }
+    if (ok && job->sync != SaveSync_None)
+        ok = syncFile(fp);
+    if (fclose(fp) != 0)
+        ok = false;
+
+    if (ok && replaceFile(tmp.c_str(), commit.c_str())) {
+#ifndef _WIN32
+        if (job->sync != SaveSync_None)
+            syncDir(job->dir.c_str());
+#endif
+        return true;
+    }
+    remove(tmp.c_str());
+    return false;
+}
+
+/*
+ * Write all files of a job to temporary files, then commit and replace the
+ * old files only if every temporary file was fully written.
+ */
+static bool writeJob(const SaveJob* job) {
+    std::string tmp;
+    FILE* fp;
+    size_t i, count = job->files.size();
+    bool ok;
+
+    // Complete any job interrupted by a crash before its files are reused.
+    if (! finishCommit(job->dir, true))
+        return false;
+
+    for (i = 0; i < count; ++i) {
+        const SaveFile& sf = job->files[i];
+        tmp = job->dir + sf.name + ".tmp";
+        fp = fopen(tmp.c_str(), "wb");
+        if (! fp) {
+            errorWarning("Cannot open save file %s", tmp.c_str());
+            goto fail;
+        }
+        ok = fwrite(sf.data.data(), 1, sf.data.size(), fp) == sf.data.size();
+        if (ok && job->sync != SaveSync_None)
+            ok = syncFile(fp);
+        if (fclose(fp) != 0)
+            ok = false;
+        if (! ok) {
+            errorWarning("Error writing save file %s", tmp.c_str());
+            ++i;
+            goto fail;
+        }
+    }
+
+    if (! writeCommit(job)) {
+        errorWarning("Cannot commit save files in %s", job->dir.c_str());
+        goto fail;
+    }
+    return finishCommit(job->dir, job->sync == SaveSync_Full);
+
+fail:
+    while (i--) {
+        tmp = job->dir + job->files[i].name + ".tmp";
+        remove(tmp.c_str());
+    }
+    return false;
+}
+
+static void writerThread() {
+    std::unique_lock<std::mutex> lock(sw.mutex);
+    SaveJob* job;
+    bool ok;
+
+    for (;;) {
+        while (! sw.head && ! sw.quit)
+            sw.wake.wait(lock);
+        if (! sw.head)
+            break;
+
+        job = sw.head;
+        sw.head = job->next;
+        if (! sw.head)
+            sw.tail = NULL;
+        sw.busy = true;
+
+        lock.unlock();
+        ok = writeJob(job);
+        delete job;
+        lock.lock();
+
+        sw.busy = false;
+        if (! ok) {
+            ++sw.failures;
+            ++sw.unreported;
+        }
+        sw.done.notify_all();
+    }
+}
+
+/**
+ * Begin a new set of save files.
+ *
+ * \param dir       Directory path (including the trailing separator).
+ * \param syncMode  SaveSyncMode.
+ */
+SaveJob* savewriter_newJob(const char* dir, int syncMode) {
+    SaveJob* job = new SaveJob;
+    job->dir  = dir;
+    job->sync = syncMode;
+    job->next = NULL;
+    job->files.reserve(4);
+    return job;
+}
+
+/**
+ * Add a file to a job.
+ *
+ * \return Pointer to size bytes which the caller must fill in before
+ *         calling savewriter_submit().
+ */
+uint8_t* savewriter_addFile(SaveJob* job, const char* name, size_t size) {
+    job->files.emplace_back();
+    SaveFile& sf = job->files.back();
+    sf.name = name;
+    sf.data.resize(size);
+    return sf.data.data();
+}
+
+/**
+ * Return the data of the file added at index, or NULL if there is no such
+ * file.
+ */
+const uint8_t* savewriter_fileData(const SaveJob* job, int index,
+                                   size_t* size) {
+    if (index < 0 || index >= (int) job->files.size())
+        return NULL;
+    const SaveFile& sf = job->files[index];
+    *size = sf.data.size();
+    return sf.data.data();
+}
+
+/**
+ * Free a job which will not be submitted.
+ */
+void savewriter_freeJob(SaveJob* job) {
+    delete job;
+}
+
+static bool sameFiles(const SaveJob* a, const SaveJob* b) {
+    size_t i, count = a->files.size();
+    if (a->dir != b->dir || count != b->files.size())
+        return false;
+    for (i = 0; i < count; ++i) {
+        if (a->files[i].name != b->files[i].name)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Queue a job for writing.  Ownership of the job passes to the writer.
+ * Any queued job for the same set of files which has not been started is
+ * dropped, as this newer one replaces them.
+ */
+void savewriter_submit(SaveJob* job) {
+    std::lock_guard<std::mutex> lock(sw.mutex);
+    SaveJob* prev = NULL;
+    SaveJob* it = sw.head;
+
+    while (it) {
+        if (sameFiles(it, job)) {
+            SaveJob* stale = it;
+            it = it->next;
+            if (prev)
+                prev->next = it;
+            else
+                sw.head = it;
+            delete stale;
+        } else {
+            prev = it;
+            it = it->next;
+        }
+    }
+    sw.tail = prev;
+
+    if (sw.tail)
+        sw.tail->next = job;
+    else
+        sw.head = job;
+    sw.tail = job;
+
+    if (! sw.thread.joinable()) {
+        sw.quit = false;
+        sw.thread = std::thread(writerThread);
+    }
+    sw.wake.notify_one();
+}
+
+/**
+ * Block until all submitted jobs have been written.  This must be called
+ * before reading any save files.
+ *
+ * \return Non-zero if all jobs since the last wait were successful.
+ */
+int savewriter_wait() {
+    std::unique_lock<std::mutex> lock(sw.mutex);
+    while (sw.head || sw.busy)
+        sw.done.wait(lock);
+
+    int ok = ! sw.failures;
+    sw.failures = 0;
+    return ok;
+}
+
+/**
+ * Return the number of jobs which have failed since the last call.
+ * Unlike savewriter_wait() this does not block, so jobs which are still
+ * being written are not counted until a later call.
+ */
+int savewriter_failures() {
+    std::lock_guard<std::mutex> lock(sw.mutex);
+    int count = sw.unreported;
+    sw.unreported = 0;
+    return count;
+}
+
+/**
+ * Complete a job in a directory which was committed but interrupted while
+ * its files were being replaced.  This must be called (after
+ * savewriter_wait) before reading the save files of dir.
+ *
+ * \param dir  Directory path (including the trailing separator).
+ *
+ * \return Non-zero if the save files in dir are a complete set.
+ */
+int savewriter_recover(const char* dir) {
+    return finishCommit(dir, true) ? 1 : 0;
+}
+
+/**
+ * Finish writing any pending jobs and stop the writer thread.
+ */
+void savewriter_shutdown() {
+    if (! sw.thread.joinable())
+        return;
+    {
+    std::lock_guard<std::mutex> lock(sw.mutex);
+    sw.quit = true;
+    sw.wake.notify_one();
+    }
+    sw.thread.join();
+}
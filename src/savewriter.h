@@ -0,0 +1,23 @@
+/*
+ * savewriter.h
+ */
+
+#ifndef SAVEWRITER_H
+#define SAVEWRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct SaveJob;
+
+SaveJob* savewriter_newJob(const char* dir, int syncMode);
+uint8_t* savewriter_addFile(SaveJob*, const char* name, size_t size);
+const uint8_t* savewriter_fileData(const SaveJob*, int index, size_t* size);
+void     savewriter_freeJob(SaveJob*);
+void     savewriter_submit(SaveJob*);
+int      savewriter_wait();
+int      savewriter_failures();
+int      savewriter_recover(const char* dir);
+void     savewriter_shutdown();
+
+#endif /* SAVEWRITER_H */
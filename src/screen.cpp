@@ -2,9 +2,11 @@
  * screen.cpp
  */
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdarg>
 #include <cfloat>
+#include <climits>
 #include <cstring>
 #include <assert.h>
 #include "u4.h"
@@ -20,6 +22,7 @@
 #include "imagemgr.h"
 #include "settings.h"
 #include "stats.h"
+#include "telemetry.h"
 #include "textview.h"
 #include "tileanim.h"
 #include "tileset.h"
@@ -34,13 +37,38 @@ using std::vector;
 
 static const int MsgBufferSize = 1024;
 
+#ifdef GPU_RENDER
+// Dungeon levels are smaller than the view, so the current level is
+// repeated to make a map of 2x2 chunks which are each larger than the view.
+#define DNG_CHUNK_DIM   (DNG_WIDTH * 2)
+#define DNG_MAP_DIM     (DNG_CHUNK_DIM * 2)
+#endif
+
 struct RenderLayer {
     void (*func)(ScreenState*, void*);
     void* data;
 };
 
+// Area of xu4.screenImage which must be transferred to the GPU.
+struct DirtyRect {
+    int16_t x, y, x2, y2;
+};
+
+#define DIRTY_MAX   8
+
 static const float colorBlack[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
 
+// Frames saved to image files for regression tests & benchmarks.
+static struct {
+    std::string dir;
+    std::vector<uint32_t> turns;    // Sorted.  Empty for every turn.
+    size_t next;
+    uint32_t turn;
+    bool cpuImage;
+    bool enabled;
+    bool pending;
+} frameCap;
+
 static const char* fontFiles[] = {
     "cfont-comfortaa.txf",
     "cfont-avatar.txf",
@@ -75,7 +103,7 @@ struct Screen {
     const Layout* gemLayout;
     const Layout* dungeonGemLayout;
     DungeonView* dungeonView;
-    std::map<string, int> dungeonTileChars;
+    vector<int8_t> dungeonTileChars;    // Charset glyph for each TileId.
     ImageInfo* charsetInfo;
     ImageInfo* gemTilesInfo;
     char* msgBuffer;
@@ -85,15 +113,23 @@ struct Screen {
     short colorFG;
     uint8_t uploadScreen;
     uint8_t layersAvail;
+    uint16_t dirtyCount;
+    DirtyRect dirty[DIRTY_MAX];
+    vector<uint16_t> gemStack;      // Flood fill scratch for screenGemUpdate.
+    vector<uint8_t> gemVisited;
 #ifdef GPU_RENDER
     ImageInfo* textureInfo;
     TileView* renderMapView;
+    uint32_t gemTex;    // Texture of the gem view or zero if not shown.
     VisualId focusReticle;
     int mapId;          // Tracks map changes.
     int blockX;         // Tracks changes to view point.
     int blockY;
     BlockingGroups* blockingUpdate;
     BlockingGroups blockingGroups;
+    int64_t fxAnimTime; // Time of last fxAnim advance (usec).
+    std::vector<VisibleSprite> sprites;
+    TileId dungeonLevel[DNG_MAP_DIM * DNG_MAP_DIM];
 #else
     uint8_t blockingGrid[VIEWPORT_W * VIEWPORT_H];
     uint8_t screenLos[VIEWPORT_W * VIEWPORT_H];
@@ -104,6 +140,7 @@ struct Screen {
         memset(layers, 0, sizeof(RenderLayer) * layerCount);
         uploadScreen = 0;
         layersAvail = layerCount;
+        dirtyCount = 0;
 
         gemLayout = NULL;
         dungeonGemLayout = NULL;
@@ -126,6 +163,7 @@ struct Screen {
 #ifdef GPU_RENDER
         textureInfo = NULL;
         renderMapView = NULL;
+        gemTex = 0;
 #endif
         txf[0] = NULL;
         loadFonts(fontFiles, 3, txf);
@@ -154,29 +192,35 @@ static void screenFindLineOfSight();
 extern void screenInit_sys(const Settings*, ScreenState*, int reset);
 extern void screenDelete_sys();
 
-static void initDungeonTileChars(std::map<string, int>& dungeonTileChars) {
-    dungeonTileChars.clear();
-    dungeonTileChars["brick_floor"] = CHARSET_FLOOR;
-    dungeonTileChars["up_ladder"] = CHARSET_LADDER_UP;
-    dungeonTileChars["down_ladder"] = CHARSET_LADDER_DOWN;
-    dungeonTileChars["up_down_ladder"] = CHARSET_LADDER_UPDOWN;
-    dungeonTileChars["chest"] = '$';
-    dungeonTileChars["ceiling_hole"] = CHARSET_FLOOR;
-    dungeonTileChars["floor_hole"] = CHARSET_FLOOR;
-    dungeonTileChars["magic_orb"] = CHARSET_ORB;
-    dungeonTileChars["ceiling_hole"] = 'T';
-    dungeonTileChars["floor_hole"] = 'T';
-    dungeonTileChars["fountain"] = 'F';
-    dungeonTileChars["secret_door"] = CHARSET_SDOOR;
-    dungeonTileChars["brick_wall"] = CHARSET_WALL;
-    dungeonTileChars["dungeon_door"] = CHARSET_ROOM;
-    dungeonTileChars["avatar"] = CHARSET_REDDOT;
-    dungeonTileChars["dungeon_room"] = CHARSET_ROOM;
-    dungeonTileChars["dungeon_altar"] = CHARSET_ANKH;
-    dungeonTileChars["energy_field"] = '^';
-    dungeonTileChars["fire_field"] = '^';
-    dungeonTileChars["poison_field"] = '^';
-    dungeonTileChars["sleep_field"] = '^';
+/*
+ * Build the table of charset glyphs used to draw dungeon tiles in the gem
+ * view.  It is indexed by TileId so drawing does no name lookups.
+ */
+static void initDungeonTileChars(vector<int8_t>& dungeonTileChars) {
+    static const char dungeonCharNames[] =
+        "brick_floor up_ladder down_ladder up_down_ladder chest"
+        " ceiling_hole floor_hole magic_orb fountain secret_door brick_wall"
+        " dungeon_door avatar dungeon_room dungeon_altar energy_field"
+        " fire_field poison_field sleep_field";
+    static const int8_t dungeonChars[19] = {
+        CHARSET_FLOOR, CHARSET_LADDER_UP, CHARSET_LADDER_DOWN,
+        CHARSET_LADDER_UPDOWN, '$',
+        'T', 'T', CHARSET_ORB, 'F', CHARSET_SDOOR, CHARSET_WALL,
+        CHARSET_ROOM, CHARSET_REDDOT, CHARSET_ROOM, CHARSET_ANKH, '^',
+        '^', '^', '^'
+    };
+    const Tileset* ts = xu4.config->tileset();
+    const Tile* tile;
+    Symbol names[19];
+
+    dungeonTileChars.assign(ts->tileCount, -1);
+
+    xu4.config->internSymbols(names, 19, dungeonCharNames);
+    for (int i = 0; i < 19; ++i) {
+        tile = ts->getByName(names[i]);
+        if (tile)
+            dungeonTileChars[tile->getId()] = dungeonChars[i];
+    }
 }
 
 static void screenInit_data(Screen* scr, Settings& settings) {
@@ -184,6 +228,7 @@ static void screenInit_data(Screen* scr, Settings& settings) {
     scr->mapId = -1;
     scr->blockX = scr->blockY = -1;
     scr->blockingUpdate = NULL;
+    scr->fxAnimTime = 0;
 #endif
 
     // Create a special purpose image that represents the whole screen.
@@ -515,7 +560,12 @@ static void screenLoadLayoutsFromConf(Screen* scr) {
         errorFatal("no dungeon gem layout found!\n");
 }
 
-vector<MapTile> screenViewportTile(unsigned int width, unsigned int height, int x, int y, bool &focus) {
+/*
+ * Fill tiles with the stack of tiles at a viewport position.
+ */
+static void screenViewportTiles(vector<MapTile>& tiles,
+                                unsigned int width, unsigned int height,
+                                int x, int y, bool &focus) {
     Map* map = c->location->map;
     Coords center = c->location->coords;
     static MapTile grass = map->tileset->getByName(Tile::sym.grass)->getId();
@@ -537,13 +587,18 @@ vector<MapTile> screenViewportTile(unsigned int width, unsigned int height, int
     /* off the edge of the map: pad with grass tiles */
     if (MAP_IS_OOB(map, tc)) {
         focus = false;
-        vector<MapTile> result;
-        result.push_back(grass);
-        return result;
+        tiles.clear();
+        tiles.push_back(grass);
+        return;
     }
 
-    vector<MapTile> tiles;
+    tiles.clear();
     c->location->getTilesAt(tiles, tc, focus);
+}
+
+vector<MapTile> screenViewportTile(unsigned int width, unsigned int height, int x, int y, bool &focus) {
+    vector<MapTile> tiles;
+    screenViewportTiles(tiles, width, height, x, y, focus);
     return tiles;
 }
 
@@ -592,30 +647,33 @@ bool screenTileUpdate(TileView *view, const Coords &coords)
 }
 
 #ifdef GPU_RENDER
-struct SpriteRenderData {
-    float* attr;
-    const float* uvTable;
-    float rect[4];
-    int cx, cy;
-};
-
-static void emitSprite(const Coords* loc, VisualId vid, void* user) {
-    SpriteRenderData* rd = (SpriteRenderData*) user;
-    float* rect = rd->rect;
-    int uvIndex = VID_INDEX(vid);
+/*
+ * Copy a dungeon level into the repeated level map.
+ * Return true if any tiles changed.
+ */
+static bool screenRepeatLevel(Screen* sp, const Map* map, int level) {
+    const TileId* src = map->data + level * DNG_WIDTH * DNG_HEIGHT;
+    TileId* row = sp->dungeonLevel;
+    bool changed = false;
+    int x, y;
 
-    // Make a quad with the view center as the origin.
-    rect[0] = (float) (loc->x - rd->cx) - 0.5f;
-    rect[1] = (float) (rd->cy - loc->y) - 0.5f;
-    rd->attr = gpu_emitQuad(rd->attr, rect, rd->uvTable + uvIndex*4);
-#if 0
-    printf("KR emitSprite %d,%d vid:%d:%d\n",
-            loc->x, loc->y, VID_BANK(vid), VID_INDEX(vid));
-#endif
+    for (y = 0; y < DNG_MAP_DIM; ++y) {
+        const TileId* it = src + (y % DNG_HEIGHT) * DNG_WIDTH;
+        for (x = 0; x < DNG_MAP_DIM; ++x) {
+            TileId id = it[x % DNG_WIDTH];
+            if (row[x] != id) {
+                row[x] = id;
+                changed = true;
+            }
+        }
+        row += DNG_MAP_DIM;
+    }
+    return changed;
 }
 
 void screenDisableMap() {
     XU4_SCREEN->renderMapView = NULL;
+    XU4_SCREEN->gemTex = 0;
 }
 
 /*
@@ -625,9 +683,19 @@ void screenUpdateMap(TileView* view, const Map* map, const Coords& center) {
     Screen* sp = XU4_SCREEN;
 
     sp->renderMapView = view;
+    sp->gemTex = 0;
 
+    if (map->type == Map::DUNGEON) {
+        // Reset map rendering data when the location or level changes.
+        if (screenRepeatLevel(sp, map, center.z) || sp->mapId != map->id) {
+            sp->mapId = map->id;
+            sp->blockX = -1;
+            gpu_resetMapData(xu4.gpu, map, sp->dungeonLevel,
+                             DNG_MAP_DIM, DNG_MAP_DIM, DNG_CHUNK_DIM);
+        }
+    }
     // Reset map rendering data when the location changes.
-    if (sp->mapId != map->id) {
+    else if (sp->mapId != map->id) {
         sp->mapId = map->id;
         sp->blockX = -1;
         gpu_resetMap(xu4.gpu, map);
@@ -639,7 +707,8 @@ void screenUpdateMap(TileView* view, const Map* map, const Coords& center) {
         sp->blockX = center.x;
         sp->blockY = center.y;
 
-        if ((map->flags & NO_LINE_OF_SIGHT) == 0) {
+        if ((map->flags & NO_LINE_OF_SIGHT) == 0 &&
+            map->type != Map::DUNGEON) {
             BlockingGroups* blocks = &sp->blockingGroups;
             map->queryBlocking(blocks,
                                center.x - view->columns / 2,
@@ -652,26 +721,33 @@ void screenUpdateMap(TileView* view, const Map* map, const Coords& center) {
     }
 
     {
-    SpriteRenderData rd;
     const Object* focusObj;
-    const float VIEW_TILE_SIZE = 1.0f;
+    VisibleSprite* sprites;
+    float* attr;
+    int radius, count;
 
-    rd.uvTable = sp->textureInfo->tileTexCoord;
-    rd.rect[2] = rd.rect[3] = VIEW_TILE_SIZE;
-    rd.cx = center.x;
-    rd.cy = center.y;
-    rd.attr = gpu_beginTris(xu4.gpu, GPU_DLIST_VIEW_OBJ);
+    // Room for the focus reticle is added to the query limit.
+    radius = view->columns / 2;
+    count = map->queryVisibleLimit(radius) + 1;
+    if (sp->sprites.size() < size_t(count))
+        sp->sprites.resize(count);
+    sprites = sp->sprites.data();
 
-    map->queryVisible(center, view->columns / 2, emitSprite, &rd, &focusObj);
+    count = map->queryVisible(center, radius, sprites, &focusObj);
 
     if (focusObj) {
         if ((screenState()->currentCycle * 4 / SCR_CYCLE_PER_SECOND) % 2) {
-            const Coords& floc = focusObj->coords;
-            emitSprite(&floc, sp->focusReticle, &rd);
+            VisibleSprite* fs = sprites + count++;
+            fs->x = focusObj->coords.x;
+            fs->y = focusObj->coords.y;
+            fs->vid = sp->focusReticle;
         }
     }
 
-    gpu_endTris(xu4.gpu, GPU_DLIST_VIEW_OBJ, rd.attr);
+    attr = gpu_beginTris(xu4.gpu, GPU_DLIST_VIEW_OBJ, count);
+    attr = gpu_emitSprites(attr, sprites, count,
+                           sp->textureInfo->tileTexCoord, center.x, center.y);
+    gpu_endTris(xu4.gpu, GPU_DLIST_VIEW_OBJ, attr);
     }
 }
 #endif
@@ -685,22 +761,25 @@ void screenUpdateMap(TileView* view, const Map* map, const Coords& center) {
  */
 void screenUpdate(TileView *view, bool showmap, bool blackout) {
     ASSERT(c != NULL, "context has not yet been initialized");
+    TELE_SCOPE(TZ_SCREEN_UPDATE);
 
+    notify_dispatch(&xu4.notifyBus);
     c->stats->redraw();
 
     if (blackout)
     {
         screenEraseMapArea();
 #ifdef GPU_RENDER
-        XU4_SCREEN->renderMapView = NULL;
+        screenDisableMap();
 #endif
     }
     else if (c->location->map->flags & FIRST_PERSON) {
-        XU4_SCREEN->dungeonView->display(c, view);
-        screenRedrawMapArea();
 #ifdef GPU_RENDER
-        XU4_SCREEN->renderMapView = NULL;
+        // The 3rd-person view re-enables map rendering.
+        screenDisableMap();
 #endif
+        XU4_SCREEN->dungeonView->display(c, view);
+        screenRedrawMapArea();
     }
     else if (showmap) {
 #ifdef GPU_RENDER
@@ -756,6 +835,85 @@ void screenUploadToGPU() {
     XU4_SCREEN->uploadScreen = 1;
 }
 
+static inline int dirtyArea(const DirtyRect* r) {
+    return (r->x2 - r->x) * (r->y2 - r->y);
+}
+
+static inline void dirtyUnion(DirtyRect* a, const DirtyRect* b) {
+    if (a->x  > b->x)  a->x  = b->x;
+    if (a->y  > b->y)  a->y  = b->y;
+    if (a->x2 < b->x2) a->x2 = b->x2;
+    if (a->y2 < b->y2) a->y2 = b->y2;
+}
+
+/**
+ * Mark an area of the screenImage as changed so that it will be transferred
+ * to the GPU by the next screenUploadToGPU().
+ *
+ * Overlapping or adjoining rectangles are merged.  If the list is full the
+ * new area is merged with the rectangle which grows the least.
+ */
+void screenDirtyRect(int x, int y, int w, int h) {
+    Screen* sp = XU4_SCREEN;
+    DirtyRect dr;
+    DirtyRect* it;
+    DirtyRect* end;
+    int x2 = x + w;
+    int y2 = y + h;
+
+    if (x < 0)
+        x = 0;
+    if (y < 0)
+        y = 0;
+    if (x2 > xu4.screenImage->w)
+        x2 = xu4.screenImage->w;
+    if (y2 > xu4.screenImage->h)
+        y2 = xu4.screenImage->h;
+    if (x >= x2 || y >= y2)
+        return;
+
+    dr.x  = x;
+    dr.y  = y;
+    dr.x2 = x2;
+    dr.y2 = y2;
+
+merge:
+    end = sp->dirty + sp->dirtyCount;
+    for (it = sp->dirty; it != end; ++it) {
+        if (dr.x <= it->x2 && it->x <= dr.x2 &&
+            dr.y <= it->y2 && it->y <= dr.y2) {
+            // Remove the touching rectangle and retry with the union.
+            dirtyUnion(&dr, it);
+            *it = end[-1];
+            --sp->dirtyCount;
+            goto merge;
+        }
+    }
+
+    if (sp->dirtyCount == DIRTY_MAX) {
+        DirtyRect* best = NULL;
+        DirtyRect un;
+        int growth;
+        int bestGrowth = INT_MAX;
+
+        for (it = sp->dirty; it != end; ++it) {
+            un = *it;
+            dirtyUnion(&un, &dr);
+            growth = dirtyArea(&un) - dirtyArea(it);
+            if (growth < bestGrowth) {
+                bestGrowth = growth;
+                best = it;
+            }
+        }
+        dirtyUnion(&dr, best);
+        *best = end[-1];
+        --sp->dirtyCount;
+        goto merge;
+    }
+
+    sp->dirty[ sp->dirtyCount++ ] = dr;
+}
+
 static void screenUploadCursor(Screen* sp, uint32_t stex) {
     int phase = sp->state.currentCycle * SCR_CYCLE_PER_SECOND / SCR_CYCLE_MAX;
 
@@ -770,6 +928,96 @@ static void screenUploadCursor(Screen* sp, uint32_t stex) {
     cimg.w = cimg.h = cdim;
     gpu_blitTexture(stex, sp->state.cursorX * cdim, sp->state.cursorY * cdim,
                     &cimg);
+
+    // Restore the screen pixels under the cursor on the next upload.
+    screenDirtyRect(sp->state.cursorX * cdim, sp->state.cursorY * cdim,
+                    cdim, cdim);
+}
+
+/**
+ * Enable saving frames as PPM images named frame-<turn>.ppm.
+ *
+ * \param dir       Output directory.
+ * \param turnList  Comma separated list of turn numbers at which to save a
+ *                  frame, or NULL to save one every turn.  The game quits
+ *                  after the last one.
+ * \param cpuImage  If true save the unscaled screenImage rather than the
+ *                  rendered frame.
+ */
+void screenSetFrameCapture(const char* dir, const char* turnList,
+                           bool cpuImage) {
+    frameCap.dir = dir;
+    if (! frameCap.dir.empty() && frameCap.dir.back() != '/')
+        frameCap.dir += '/';
+    frameCap.turns.clear();
+    frameCap.next = 0;
+    frameCap.cpuImage = cpuImage;
+    frameCap.enabled = true;
+    frameCap.pending = false;
+
+    if (turnList) {
+        char* end;
+        const char* it = turnList;
+        while (*it) {
+            frameCap.turns.push_back(strtoul(it, &end, 10));
+            if (end == it)
+                errorFatal("Invalid frame turn list: %s", turnList);
+            it = (*end == ',') ? end + 1 : end;
+        }
+        std::sort(frameCap.turns.begin(), frameCap.turns.end());
+    }
+}
+
+/**
+ * Called at the end of each game turn to schedule a frame capture on the
+ * next render.
+ */
+void screenCaptureTurn(uint32_t turn) {
+    size_t count = frameCap.turns.size();
+
+    if (! frameCap.enabled)
+        return;
+    if (count) {
+        if (frameCap.next >= count || turn < frameCap.turns[frameCap.next])
+            return;
+        while (frameCap.next < count && frameCap.turns[frameCap.next] <= turn)
+            ++frameCap.next;
+    }
+    frameCap.turn = turn;
+    frameCap.pending = true;
+}
+
+/**
+ * Return the number of turns listed for frame capture which have not been
+ * saved.
+ */
+int screenCaptureMissed() {
+    if (frameCap.turns.empty())
+        return 0;
+    return int(frameCap.turns.size() - frameCap.next) +
+           (frameCap.pending ? 1 : 0);
+}
+
+static void screenCaptureFrame(const ScreenState* ss) {
+    char name[24];
+    std::string path;
+
+    frameCap.pending = false;
+    snprintf(name, sizeof(name), "frame-%06u.ppm", frameCap.turn);
+    path = frameCap.dir + name;
+
+    if (frameCap.cpuImage) {
+        xu4.screenImage->save(path.c_str());
+    } else {
+        Image32 img;
+        image32_allocPixels(&img, ss->aspectW, ss->aspectH);
+        gpu_readPixels(ss->aspectX, ss->aspectY, &img);
+        image32_savePPM(&img, path.c_str());
+        image32_freePixels(&img);
+    }
+
+    if (frameCap.turns.size() && frameCap.next >= frameCap.turns.size())
+        xu4.eventHandler->quitGame();
 }
 
 void screenRender() {
@@ -779,10 +1027,16 @@ void screenRender() {
     int offsetY = ss->aspectY;
 
     if (sp->uploadScreen) {
+        TELE_SCOPE(TZ_UPLOAD);
         sp->uploadScreen = 0;
 
         uint32_t stex = gpu_screenTexture(xu4.gpu);
-        gpu_blitTexture(stex, 0, 0, xu4.screenImage);
+        const DirtyRect* it  = sp->dirty;
+        const DirtyRect* end = it + sp->dirtyCount;
+        for (; it != end; ++it)
+            gpu_blitTextureRect(stex, xu4.screenImage,
+                                it->x, it->y, it->x2 - it->x, it->y2 - it->y);
+        sp->dirtyCount = 0;
 
         if (sp->state.cursorVisible)
             screenUploadCursor(sp, stex);
@@ -802,13 +1056,28 @@ void screenRender() {
         if (view->scissor)
             gpu_setScissor(view->scissor);
 
+        {
+        TELE_SCOPE(TZ_DRAW_MAP);
         gpu_drawMap(gpu, view, sp->textureInfo->tileTexCoord,
                     sp->blockingUpdate, sp->blockX, sp->blockY, view->scale);
+        }
         sp->blockingUpdate = NULL;
 
         gpu_drawTris(gpu, GPU_DLIST_VIEW_OBJ);
 
-        anim_advance(&xu4.eventHandler->fxAnim, 1.0f / 24.0f);
+        {
+        // Advance effects by the real time elapsed, limited so that a long
+        // stall does not make projectiles jump.
+        int64_t now = usecTicks();
+        float dt = 0.0f;
+        if (sp->fxAnimTime) {
+            dt = float(now - sp->fxAnimTime) * 0.000001f;
+            if (dt > 0.1f)
+                dt = 0.1f;
+        }
+        sp->fxAnimTime = now;
+        anim_advance(&xu4.eventHandler->fxAnim, dt);
+        }
         view->updateEffects((float) sp->blockX,
                             (float) sp->blockY,
                             sp->textureInfo->tileTexCoord);
@@ -822,6 +1091,9 @@ void screenRender() {
 
         gpu_viewport(ss->aspectX, offsetY, ss->aspectW, ss->aspectH);
     }
+    else if (sp->gemTex) {
+        gpu_drawTrisImage(gpu, GPU_DLIST_VIEW_OBJ, sp->gemTex);
+    }
 #endif
 
     {
@@ -832,6 +1104,9 @@ void screenRender() {
             rl->func(ss, rl->data);
     }
     }
+
+    if (frameCap.pending)
+        screenCaptureFrame(ss);
 }
 
 void screenDrawImageInMapArea(Symbol name) {
@@ -1476,118 +1751,155 @@ void screenShake(int iterations) {
     }
 }
 
-/**
- * Draw a tile graphic on the screen.
+/*
+ * Return the row of the graphic for tile t in the gem view image, or -1 if
+ * the tile is shown as black.
  */
-static void screenShowGemTile(const Layout *layout, const Map *map,
-                              MapTile &t, bool focus, int x, int y) {
-    Screen* scr = XU4_SCREEN;
-    unsigned int tile = xu4.config->usaveIds()->ultimaId(t);
-
+static int screenGemRow(const Screen* scr, const Map* map, const MapTile& t) {
     if (map->type == Map::DUNGEON) {
-        ImageInfo* charsetInfo = scr->charsetInfo;
-
-        std::map<string, int>::iterator charIndex = scr->dungeonTileChars.find(t.getTileType()->nameStr());
-        if (charIndex != scr->dungeonTileChars.end()) {
-            charsetInfo->image->drawSubRect(
-                layout->viewport.x + (x * layout->tileshape.width),
-                layout->viewport.y + (y * layout->tileshape.height),
-                0,
-                charIndex->second * layout->tileshape.height,
-                layout->tileshape.width,
-                layout->tileshape.height);
-        }
+        return (t.id < scr->dungeonTileChars.size()) ?
+               scr->dungeonTileChars[t.id] : -1;
     }
-    else {
-        if (scr->gemTilesInfo == NULL) {
-            scr->gemTilesInfo = xu4.imageMgr->get(BKGD_GEMTILES);
-            if (! scr->gemTilesInfo)
-                errorLoadImage(BKGD_GEMTILES);
-        }
+    unsigned int tile = xu4.config->usaveIds()->ultimaId(t);
+    return (tile < 128) ? int(tile) : -1;
+}
 
-        if (tile < 128) {
-            scr->gemTilesInfo->image->drawSubRect(
-                layout->viewport.x + (x * layout->tileshape.width),
-                layout->viewport.y + (y * layout->tileshape.height),
-                0,
-                tile * layout->tileshape.height,
-                layout->tileshape.width,
-                layout->tileshape.height);
-        } else {
-            xu4.screenImage->fillRect(
-                layout->viewport.x + (x * layout->tileshape.width),
-                layout->viewport.y + (y * layout->tileshape.height),
-                layout->tileshape.width,
-                layout->tileshape.height,
-                0, 0, 0);
-        }
-    }
+struct GemDraw {
+    const Layout* layout;
+    const Image* image;
+#ifdef GPU_RENDER
+    float* attr;
+#endif
+};
+
+/**
+ * Draw a tile graphic on the screen.
+ */
+static void screenShowGemTile(GemDraw* gd, const MapTile& t, int x, int y) {
+    const Layout* layout = gd->layout;
+    int row = screenGemRow(XU4_SCREEN, c->location->map, t);
+    if (row < 0)
+        return;     // The map area has already been cleared to black.
+
+    int w = layout->tileshape.width;
+    int h = layout->tileshape.height;
+    int dx = layout->viewport.x + x * w;
+    int dy = layout->viewport.y + y * h;
+#ifdef GPU_RENDER
+    const Image* img = gd->image;
+    float rect[4];
+    float uv[4];
+
+    rect[0] = (float) dx;
+    rect[1] = (float) (U4_SCREEN_H - dy - h);
+    rect[2] = (float) w;
+    rect[3] = (float) h;
+    uv[0] = 0.0f;
+    uv[1] = (float) (row * h) / img->h;
+    uv[2] = (float) w / img->w;
+    uv[3] = (float) ((row + 1) * h) / img->h;
+    gd->attr = gpu_emitQuad(gd->attr, rect, uv);
+#else
+    gd->image->drawSubRect(dx, dy, 0, row * h, w, h);
+#endif
 }
 
+/*
+ * Draw the gem (or telescope) view of the current map.
+ *
+ * With GPU_RENDER the tiles are emitted as quads and drawn each frame by
+ * screenRender(), so the map area of the screen image is only cleared
+ * when the view is first shown.
+ */
 void screenGemUpdate() {
+    Screen* sp = XU4_SCREEN;
+    vector<MapTile> tiles;
     MapTile tile;
     int x, y;
-    const Layout* layout;
+    GemDraw gd;
+    ImageInfo* info;
     const Map* map = c->location->map;
     bool focus;
 
-    xu4.screenImage->fillRect(BORDER_WIDTH,
-                              BORDER_HEIGHT,
-                              VIEWPORT_W * TILE_WIDTH,
-                              VIEWPORT_H * TILE_HEIGHT,
-                              0, 0, 0);
+    if (map->type == Map::DUNGEON) {
+        gd.layout = sp->dungeonGemLayout;
+        info = sp->charsetInfo;
+    } else {
+        gd.layout = sp->gemLayout;
+        if (sp->gemTilesInfo == NULL) {
+            sp->gemTilesInfo = xu4.imageMgr->get(BKGD_GEMTILES);
+            if (! sp->gemTilesInfo)
+                errorLoadImage(BKGD_GEMTILES);
+        }
+        info = sp->gemTilesInfo;
+    }
+    gd.image = info->image;
+
+    const int vw = gd.layout->viewport.width;
+    const int vh = gd.layout->viewport.height;
+
+#ifdef GPU_RENDER
+    if (! sp->gemTex)
+        screenEraseMapArea();
+    sp->renderMapView = NULL;
+
+    if (! info->tex)
+        info->tex = gpu_makeTexture(info->image);
+    sp->gemTex = info->tex;
+
+    // The gem view replaces the map so it shares the map sprite list.
+    gd.attr = gpu_beginTris(xu4.gpu, GPU_DLIST_VIEW_OBJ, vw * vh);
+#else
+    screenEraseMapArea();
+#endif
 
     if (map->type == Map::DUNGEON) {
         //DO THE SPECIAL DUNGEON MAP TRAVERSAL
-        layout = XU4_SCREEN->dungeonGemLayout;
-
-        vector<vector<int> > drawnTiles(layout->viewport.width, vector<int>(layout->viewport.height, 0));
-        vector<std::pair<int,int> > coordStack;
-        vector<MapTile> tiles;
         const Coords& coords = c->location->coords;
+        const TileId avatarTileId =
+            map->tileset->getByName(Tile::sym.avatar)->getId();
+        uint16_t* stack;
+        uint8_t* visited;
+        int sn, i, nx, ny;
+
+        // Each cell is pushed at most once as it is marked when pushed.
+        sp->gemStack.resize(vw * vh);
+        sp->gemVisited.assign(vw * vh, 0);
+        stack   = &sp->gemStack.front();
+        visited = &sp->gemVisited.front();
 
         //Put the avatar's position on the stack
-        int center_x = layout->viewport.width / 2 - 1;
-        int center_y = layout->viewport.height / 2 - 1;
+        int center_x = vw / 2 - 1;
+        int center_y = vh / 2 - 1;
         int avt_x = coords.x - 1;
         int avt_y = coords.y - 1;
 
-        coordStack.push_back(std::pair<int,int>(center_x, center_y));
+        i = center_y * vw + center_x;
+        visited[i] = 1;
+        stack[0] = i;
+        sn = 1;
         bool weAreDrawingTheAvatarTile = true;
 
         //And draw each tile on the growing stack until it is empty
-        while (coordStack.size() > 0) {
-            const std::pair<int,int>& currentXY = coordStack.back();
-            x = currentXY.first;
-            y = currentXY.second;
-            coordStack.pop_back();
-
-            if (x < 0 || x >= layout->viewport.width ||
-                y < 0 || y >= layout->viewport.height)
-                continue;   //Skip out of range tiles
-
-            if (drawnTiles[x][y])
-                continue;   //Skip already considered tiles
-
-            drawnTiles[x][y] = 1;
+        while (sn) {
+            i = stack[--sn];
+            x = i % vw;
+            y = i / vw;
 
             // DRAW THE ACTUAL TILE
-            tiles = screenViewportTile(layout->viewport.width,
-                                       layout->viewport.height,
-                                       x - center_x + avt_x,
-                                       y - center_y + avt_y, focus);
+            screenViewportTiles(tiles, vw, vh,
+                                x - center_x + avt_x,
+                                y - center_y + avt_y, focus);
             tile = tiles.front();
 
             if (! weAreDrawingTheAvatarTile) {
                 // Hack to avoid showing the avatar tile multiple times in
                 // repeating dungeon maps
-                TileId avatarTileId =
-                    map->tileset->getByName(Tile::sym.avatar)->getId();
                 if (tile.getId() == avatarTileId)
                     tile = map->getTileFromData(coords);
             }
 
-            screenShowGemTile(layout, map, tile, focus, x, y);
+            screenShowGemTile(&gd, tile, x, y);
 
             if (! tile.getTileType()->isOpaque() ||
                 tile.getTileType()->isWalkable() || weAreDrawingTheAvatarTile)
@@ -1595,19 +1907,21 @@ void screenGemUpdate() {
                 // Continue the search so we can see through all walkable
                 // objects, non-opaque objects (like creatures) or the avatar
                 // position in those rare circumstances where he is stuck in a
-                // wall by adding all relative adjacency combinations to the
-                // stack for drawing
-
-                coordStack.push_back(std::pair<int,int>(x + 1,  y - 1));
-                coordStack.push_back(std::pair<int,int>(x + 1,  y    ));
-                coordStack.push_back(std::pair<int,int>(x + 1,  y + 1));
-
-                coordStack.push_back(std::pair<int,int>(x    ,  y - 1));
-                coordStack.push_back(std::pair<int,int>(x    ,  y + 1));
-
-                coordStack.push_back(std::pair<int,int>(x - 1,  y - 1));
-                coordStack.push_back(std::pair<int,int>(x - 1,  y    ));
-                coordStack.push_back(std::pair<int,int>(x - 1,  y + 1));
+                // wall by adding all in range adjacent tiles to the stack.
+
+                for (ny = y - 1; ny <= y + 1; ++ny) {
+                    if (ny < 0 || ny >= vh)
+                        continue;
+                    for (nx = x - 1; nx <= x + 1; ++nx) {
+                        if (nx < 0 || nx >= vw)
+                            continue;
+                        i = ny * vw + nx;
+                        if (! visited[i]) {
+                            visited[i] = 1;
+                            stack[sn++] = i;
+                        }
+                    }
+                }
 
                 // We only draw the avatar tile once, it is the first tile drawn
                 weAreDrawingTheAvatarTile = false;
@@ -1615,17 +1929,17 @@ void screenGemUpdate() {
         }
     } else {
         //DO THE REGULAR EVERYTHING-IS-VISIBLE MAP TRAVERSAL
-        layout = XU4_SCREEN->gemLayout;
-
-        for (x = 0; x < layout->viewport.width; x++) {
-            for (y = 0; y < layout->viewport.height; y++) {
-                tile = screenViewportTile(layout->viewport.width,
-                                          layout->viewport.height, x, y, focus).front();
-                screenShowGemTile(layout, map, tile, focus, x, y);
+        for (x = 0; x < vw; x++) {
+            for (y = 0; y < vh; y++) {
+                screenViewportTiles(tiles, vw, vh, x, y, focus);
+                screenShowGemTile(&gd, tiles.front(), x, y);
             }
         }
     }
 
+#ifdef GPU_RENDER
+    gpu_endTris(xu4.gpu, GPU_DLIST_VIEW_OBJ, gd.attr);
+#endif
     screenRedrawMapArea();
 
     screenUpdateMoons();
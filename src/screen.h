@@ -105,6 +105,11 @@ void screenSetLayer(int layer, void (*renderFunc)(ScreenState*, void*),
 void screenSwapBuffers();
 void screenWait(int numberOfAnimationFrames);
 void screenUploadToGPU();
+void screenDirtyRect(int x, int y, int w, int h);
+void screenSetFrameCapture(const char* dir, const char* turnList,
+                           bool cpuImage);
+void screenCaptureTurn(uint32_t turn);
+int  screenCaptureMissed();
 
 void screenIconify(void);
 
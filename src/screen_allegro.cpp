@@ -130,6 +130,9 @@ void screenInit_sys(const Settings* settings, ScreenState* state, int reset) {
         if (source)
             al_unregister_event_source(sa->queue, source);
     } else {
+        if (xu4.headless)
+            errorFatal("Headless mode requires EGL support");
+
         xu4.screenSys = sa = new ScreenAllegro;
         xu4.gpu = &sa->gpu;
         memset(sa, 0, sizeof(ScreenAllegro));
@@ -18,16 +18,27 @@
 #include <glv.h>
 #include <glv_keys.h>
 
+#ifdef USE_EGL
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
 #define CURSORSIZE 20
 #define XPMSIZE    32
 #include "cursors.h"
 
 struct ScreenGLView {
-    GLView* view;
+    GLView* view;               // NULL when headless.
     Controller* waitCon;
     updateScreenCallback update;
     int currentCursor;
     OpenGLResources gpu;
+#ifdef USE_EGL
+    EGLDisplay eglDisplay;
+    EGLContext eglContext;
+    EGLSurface eglSurface;
+#endif
 };
 
 #define SA  ((ScreenGLView*) xu4.screenSys)
@@ -112,6 +123,112 @@ static void _setX11Icon(GLView* view, const char* filename) {
 #include "gpu_opengl.cpp"
 
 
+#ifdef USE_EGL
+/*
+ * Create a pbuffer surface to use as the default framebuffer when headless.
+ */
+static bool _headlessSurface(ScreenGLView* sa, EGLConfig config, int w, int h)
+{
+    const EGLint surfAttr[] = {
+        EGL_WIDTH, w,
+        EGL_HEIGHT, h,
+        EGL_NONE
+    };
+
+    if (sa->eglSurface) {
+        eglMakeCurrent(sa->eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                       EGL_NO_CONTEXT);
+        eglDestroySurface(sa->eglDisplay, sa->eglSurface);
+    }
+    sa->eglSurface = eglCreatePbufferSurface(sa->eglDisplay, config, surfAttr);
+    if (sa->eglSurface == EGL_NO_SURFACE)
+        return false;
+    return eglMakeCurrent(sa->eglDisplay, sa->eglSurface, sa->eglSurface,
+                          sa->eglContext) == EGL_TRUE;
+}
+
+static EGLConfig _headlessConfig(EGLDisplay display)
+{
+    const EGLint configAttr[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint count;
+
+    if (! eglChooseConfig(display, configAttr, &config, 1, &count) || ! count)
+        return NULL;
+    return config;
+}
+
+/*
+ * Create an offscreen OpenGL context using the Mesa surfaceless platform
+ * if available so that no display server is needed.
+ *
+ * Return error string or NULL if successful.
+ */
+static const char* _headlessCreate(ScreenGLView* sa, int w, int h,
+                                   int glVersion)
+{
+    const EGLint contextAttr[] = {
+        EGL_CONTEXT_MAJOR_VERSION, glVersion >> 8,
+        EGL_CONTEXT_MINOR_VERSION, glVersion & 0xff,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay;
+    EGLConfig config;
+
+    getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+                         eglGetProcAddress("eglGetPlatformDisplayEXT");
+    sa->eglDisplay = EGL_NO_DISPLAY;
+    if (getPlatformDisplay)
+        sa->eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                            EGL_DEFAULT_DISPLAY, NULL);
+    if (sa->eglDisplay == EGL_NO_DISPLAY)
+        sa->eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (sa->eglDisplay == EGL_NO_DISPLAY ||
+        ! eglInitialize(sa->eglDisplay, NULL, NULL))
+        return "EGL display";
+
+    if (! eglBindAPI(EGL_OPENGL_API))
+        return "EGL OpenGL API";
+
+    config = _headlessConfig(sa->eglDisplay);
+    if (! config)
+        return "EGL config";
+
+    sa->eglContext = eglCreateContext(sa->eglDisplay, config, EGL_NO_CONTEXT,
+                                      contextAttr);
+    if (sa->eglContext == EGL_NO_CONTEXT)
+        return "EGL context";
+
+    // GL functions are linked directly and dispatch to the current
+    // context, so there is nothing to load.
+    if (! _headlessSurface(sa, config, w, h))
+        return "EGL pbuffer";
+    return NULL;
+}
+
+static void _headlessDestroy(ScreenGLView* sa)
+{
+    if (sa->eglDisplay == EGL_NO_DISPLAY)
+        return;
+    eglMakeCurrent(sa->eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                   EGL_NO_CONTEXT);
+    if (sa->eglSurface)
+        eglDestroySurface(sa->eglDisplay, sa->eglSurface);
+    if (sa->eglContext)
+        eglDestroyContext(sa->eglDisplay, sa->eglContext);
+    eglTerminate(sa->eglDisplay);
+}
+#endif
+
+
 static void handleKeyDownEvent(const GLViewEvent* event,
                                Controller *controller,
                                updateScreenCallback updateScreen) {
@@ -275,17 +392,42 @@ void screenInit_sys(const Settings* settings, ScreenState* state, int reset) {
 
         memset(sa, 0, sizeof(ScreenGLView));
 
-        sa->view = glv_create(GLV_ATTRIB_DOUBLEBUFFER, glVersion);
-        if (! sa->view)
-            goto fatal;
+        if (xu4.headless) {
+#ifdef USE_EGL
+            gpuError = _headlessCreate(sa, dw, dh, glVersion);
+            if (gpuError)
+                errorFatal("Unable to create headless context (%s)",
+                           gpuError);
+#else
+            errorFatal("Headless mode requires EGL support");
+#endif
+        } else {
+            sa->view = glv_create(GLV_ATTRIB_DOUBLEBUFFER, glVersion);
+            if (! sa->view)
+                goto fatal;
 
-        sa->view->user = sa;
-        glv_setTitle(sa->view, "Ultima IV");  // configService->gameName()
-        glv_setEventHandler(sa->view, eventHandler);
+            sa->view->user = sa;
+            glv_setTitle(sa->view, "Ultima IV");  // configService->gameName()
+            glv_setEventHandler(sa->view, eventHandler);
 
 #if defined(__linux__) && ! defined(ANDROID)
-        _setX11Icon(sa->view, "/usr/share/icons/hicolor/48x48/apps/xu4.png");
+            _setX11Icon(sa->view,
+                        "/usr/share/icons/hicolor/48x48/apps/xu4.png");
 #endif
+        }
+    }
+
+    if (! sa->view) {
+        // Headless; the pbuffer is exactly the scaled screen size.
+#ifdef USE_EGL
+        if (reset && ! _headlessSurface(sa,
+                                _headlessConfig(sa->eglDisplay), dw, dh))
+            errorFatal("Unable to resize headless context");
+#endif
+        state->displayW = state->aspectW = dw;
+        state->displayH = state->aspectH = dh;
+        state->aspectX = state->aspectY = 0;
+        goto init_gpu;
     }
 
     {
@@ -336,6 +478,7 @@ void screenInit_sys(const Settings* settings, ScreenState* state, int reset) {
         glv_showCursor(sa->view, 0);
     }
 
+init_gpu:
     gpuError = gpu_init(&sa->gpu, dw, dh, scale, settings->filter);
     if (gpuError)
         errorFatal("Unable to obtain OpenGL resource (%s)", gpuError);
@@ -351,8 +494,14 @@ void screenDelete_sys() {
 
     gpu_free(&sa->gpu);
 
-    glv_destroy(sa->view);
-    sa->view = NULL;
+    if (sa->view) {
+        glv_destroy(sa->view);
+        sa->view = NULL;
+    }
+#ifdef USE_EGL
+    else
+        _headlessDestroy(sa);
+#endif
 
     delete sa;
     xu4.screenSys = NULL;
@@ -362,7 +511,8 @@ void screenDelete_sys() {
  * Attempts to iconify the screen.
  */
 void screenIconify() {
-    glv_iconify(SA->view);
+    if (SA->view)
+        glv_iconify(SA->view);
 }
 
 //#define CPU_TEST
@@ -373,7 +523,8 @@ extern void screenRender();
 void screenSwapBuffers() {
     CPU_START()
     screenRender();
-    glv_swapBuffers(SA->view);
+    if (SA->view)
+        glv_swapBuffers(SA->view);
     CPU_END("ut:")
 }
 
@@ -399,6 +550,8 @@ void screenSetMouseCursor(MouseCursor cursor) {
 #ifndef ANDROID
     ScreenGLView* sa = SA;
 
+    if (! sa->view)
+        return;
     if (cursor != sa->currentCursor) {
         if (cursor == MC_DEFAULT)
             glv_showCursor(sa->view, 1);
@@ -410,7 +563,8 @@ void screenSetMouseCursor(MouseCursor cursor) {
 }
 
 void screenShowMouseCursor(bool visible) {
-    glv_showCursor(SA->view, visible ? 1 : 0);
+    if (SA->view)
+        glv_showCursor(SA->view, visible ? 1 : 0);
 }
 
 /*
@@ -424,6 +578,9 @@ void EventHandler::handleInputEvents(Controller* waitCon,
     Controller* prevCon = sa->waitCon;
     updateScreenCallback prevUpdate = sa->update;
 
+    if (! sa->view)
+        return;     // Headless input only comes from a recording.
+
     sa->waitCon = waitCon;
     sa->update  = update;
 
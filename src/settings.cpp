@@ -237,6 +237,7 @@ bool Settings::read() {
     screenAnimationFramesPerSecond = DEFAULT_ANIMATION_FRAMES_PER_SECOND;
     debug                 = DEFAULT_DEBUG;
     battleDiff            = DEFAULT_BATTLE_DIFFICULTY;
+    saveSync              = DEFAULT_SAVE_SYNC;
     spellEffectSpeed      = DEFAULT_SPELL_EFFECT_SPEED;
     campTime              = DEFAULT_CAMP_TIME;
     innTime               = DEFAULT_INN_TIME;
@@ -244,6 +245,8 @@ bool Settings::read() {
     shakeInterval         = DEFAULT_SHAKE_INTERVAL;
     titleSpeedRandom      = DEFAULT_TITLE_SPEED_RANDOM;
     titleSpeedOther       = DEFAULT_TITLE_SPEED_OTHER;
+    autosaveTurns         = DEFAULT_AUTOSAVE_TURNS;
+    autosaveSlots         = DEFAULT_AUTOSAVE_SLOTS;
 
 #if 0
     pauseForEachMovement  = DEFAULT_PAUSE_FOR_EACH_MOVEMENT;
@@ -331,6 +334,8 @@ bool Settings::read() {
             debug = toInt(val);
         else if (VALUE("battleDiff="))
             battleDiff = settingEnum(battleDiffStrings(), val);
+        else if (VALUE("saveSync="))
+            saveSync = settingEnum(saveSyncStrings(), val);
         else if (VALUE("spellEffectSpeed="))
             spellEffectSpeed = toInt(val);
         else if (VALUE("campTime="))
@@ -345,6 +350,10 @@ bool Settings::read() {
             titleSpeedRandom = toInt(val);
         else if (VALUE("titleSpeedOther="))
             titleSpeedOther = toInt(val);
+        else if (VALUE("autosaveTurns="))
+            autosaveTurns = toInt(val);
+        else if (VALUE("autosaveSlots="))
+            autosaveSlots = toInt(val);
 
         /* minor enhancement options */
         else if (VALUE("activePlayer="))
@@ -432,13 +441,16 @@ bool Settings::write() {
             "gameCyclesPerSecond=%d\n"
             "debug=%d\n"
             "battleDiff=%s\n"
+            "saveSync=%s\n"
             "spellEffectSpeed=%d\n"
             "campTime=%d\n"
             "innTime=%d\n"
             "shrineTime=%d\n"
             "shakeInterval=%d\n"
             "titleSpeedRandom=%d\n"
-            "titleSpeedOther=%d\n",
+            "titleSpeedOther=%d\n"
+            "autosaveTurns=%d\n"
+            "autosaveSlots=%d\n",
             scale,
             fullscreen,
             screenGetFilterNames()[ filter ],
@@ -458,13 +470,16 @@ bool Settings::write() {
             gameCyclesPerSecond,
             debug,
             battleDiffStrings()[ battleDiff ],
+            saveSyncStrings()[ saveSync ],
             spellEffectSpeed,
             campTime,
             innTime,
             shrineTime,
             shakeInterval,
             titleSpeedRandom,
-            titleSpeedOther);
+            titleSpeedOther,
+            autosaveTurns,
+            autosaveSlots);
 
     // Enhancements Options
     fprintf(settingsFile,
@@ -518,3 +533,8 @@ const char** Settings::battleDiffStrings() {
     static const char* difficulty[] = {"Normal", "Hard", "Expert", NULL};
     return difficulty;
 }
+
+const char** Settings::saveSyncStrings() {
+    static const char* modes[] = {"None", "Files", "Full", NULL};
+    return modes;
+}
@@ -50,9 +50,12 @@
 #define DEFAULT_SHRINE_TIME             16
 #define DEFAULT_SHAKE_INTERVAL          100
 #define DEFAULT_BATTLE_DIFFICULTY       BattleDiff_Normal
+#define DEFAULT_SAVE_SYNC               SaveSync_Files
 #define DEFAULT_LOGGING                 ""
 #define DEFAULT_TITLE_SPEED_RANDOM      150
 #define DEFAULT_TITLE_SPEED_OTHER       30
+#define DEFAULT_AUTOSAVE_TURNS          100
+#define DEFAULT_AUTOSAVE_SLOTS          4
 
 #define DEFAULT_PAUSE_FOR_EACH_TURN     100
 #define DEFAULT_PAUSE_FOR_EACH_MOVEMENT 10
@@ -67,6 +70,12 @@ enum BattleDifficulty {
     BattleDiff_Expert
 };
 
+enum SaveSyncMode {
+    SaveSync_None,      // Leave flushing to the OS.
+    SaveSync_Files,     // Flush each file before it replaces the old one.
+    SaveSync_Full       // Also flush the directory after the renames.
+};
+
 struct SettingsEnhancementOptions {
     bool activePlayer;
     bool u5spellMixing;
@@ -122,9 +131,12 @@ public:
     bool                volumeFades;
     int                 titleSpeedRandom;
     int                 titleSpeedOther;
+    int                 autosaveTurns;  // Zero disables autosave.
+    int                 autosaveSlots;
     uint8_t             battleDiff;     // Used by Creature
     uint8_t             filter;         // Defined by screen
     uint8_t             lineOfSight;    // Defined by screen
+    uint8_t             saveSync;       // SaveSyncMode
     char game[40];
     char soundtrack[40];
 
@@ -148,6 +160,7 @@ class Settings : public SettingsData {
 public:
     static uint8_t settingEnum(const char** names, const char* value);
     static const char** battleDiffStrings();
+    static const char** saveSyncStrings();
 
     void init(const char* profileName);
     void setData(const SettingsData &data);
@@ -0,0 +1,386 @@
+/*
+ * snapshot.cpp
+ *
+ * In-memory copies of the game simulation state.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "config.h"
+#include "context.h"
+#include "map.h"
+#include "party.h"
+#include "snapshot.h"
+#include "xu4.h"
+
+#define SNAP_ALIGN      8
+#define SNAP_PAD(n)     (((n) + SNAP_ALIGN - 1) & ~(size_t) (SNAP_ALIGN - 1))
+
+struct SnapContext {
+    int moonPhase;
+    int windDirection;
+    int windCounter;
+    int horseSpeed;
+    int opacity;
+    int transportContext;
+    uint32_t lastCommandTime;
+    uint32_t commandTimer;
+    Aura aura;
+    bool windLock;
+};
+
+/*
+ * Each Location is followed by the map tiles, annotations & objects.
+ * All records begin on a SNAP_ALIGN boundary.
+ */
+struct SnapLocation {
+    Coords coords;
+    int32_t viewMode;
+    uint32_t context;
+    uint32_t tileCount;
+    uint32_t annoCount;
+    uint32_t objCount;
+    MapId mapId;
+};
+
+struct SnapObject {
+    uint32_t size;          // Bytes in record including this header.
+    uint32_t objType;
+};
+
+struct GameSnapshot {
+    uint32_t size;          // Total bytes including this header.
+    uint16_t locCount;
+    int16_t  lastShipLoc;   // Location index of Context::lastShip or -1.
+    int32_t  lastShipObj;   // Object index on that Location map.
+    uint32_t random[XU4_RANDOM_STATE_LEN];      // Simulation generator.
+    uint32_t randomFx[XU4_RANDOM_STATE_LEN];
+    SaveGame save;
+    PartyState party;
+    SnapContext ctx;
+    // Followed by locCount SnapLocation records, current Location first.
+};
+
+static size_t objectSize(int objType) {
+    switch (objType) {
+        case Object::CREATURE:
+            return sizeof(Creature);
+        case Object::PERSON:
+            return sizeof(Person);
+        default:
+            return sizeof(Object);
+    }
+}
+
+/*
+ * Copy-construct an object of the same type as src.
+ * If dst is NULL then the object is allocated on the heap.
+ */
+static Object* copyObject(void* dst, const Object* src) {
+    Object* obj;
+
+    switch (src->objType) {
+        case Object::CREATURE:
+            if (dst)
+                obj = new (dst) Creature(*static_cast<const Creature*>(src));
+            else
+                obj = new Creature(*static_cast<const Creature*>(src));
+            break;
+        case Object::PERSON:
+            if (dst)
+                obj = new (dst) Person(*static_cast<const Person*>(src));
+            else
+                obj = new Person(*static_cast<const Person*>(src));
+            break;
+        default:
+            if (dst)
+                obj = new (dst) Object(*src);
+            else
+                obj = new Object(*src);
+            break;
+    }
+
+    // The copy does not own the frame animation or map membership.
+    obj->animId = ANIM_UNUSED;
+    obj->onMaps = 0;
+    return obj;
+}
+
+static uint32_t mapTileCount(const Map* map) {
+    return map->data ? map->width * map->height * map->levels : 0;
+}
+
+/*
+ * Return the bytes needed to hold a Location or zero if it cannot be
+ * captured.
+ */
+static size_t locationSize(const Location* loc) {
+    const Map* map = loc->map;
+    size_t size;
+
+    if (loc->context & CTX_COMBAT)
+        return 0;
+
+    size = SNAP_PAD(sizeof(SnapLocation)) +
+           SNAP_PAD(mapTileCount(map) * sizeof(TileId)) +
+           SNAP_PAD(map->annotations.size() * sizeof(Annotation));
+
+    ObjectVector::const_iterator it;
+    foreach (it, map->objects) {
+        const Object* obj = *it;
+        if (obj->onMaps > 1 || isPartyMember(obj))
+            return 0;
+        size += SNAP_PAD(sizeof(SnapObject)) +
+                SNAP_PAD(objectSize(obj->objType));
+    }
+    return size;
+}
+
+/**
+ * Make a copy of the game simulation state in a single memory block.
+ *
+ * The state includes the SaveGame, Party, Context values, the Location
+ * stack along with the tiles, annotations & objects of each map, and the
+ * random number generator states.
+ *
+ * Capturing does not alter the state, so the game continues on the same
+ * path it would have without the snapshot.
+ *
+ * The snapshot holds live C++ objects and can only be used by the process
+ * which created it.
+ *
+ * \return Snapshot pointer or NULL if the state cannot be captured (during
+ *         combat).  Free it with snapshot_free().
+ */
+GameSnapshot* snapshot_capture(const Context* ctx) {
+    GameSnapshot* snap;
+    const Location* loc;
+    uint8_t* pos;
+    size_t size, locSize;
+    int locIndex;
+
+    size = SNAP_PAD(sizeof(GameSnapshot));
+    for (loc = ctx->location; loc; loc = loc->prev) {
+        locSize = locationSize(loc);
+        if (! locSize)
+            return NULL;
+        size += locSize;
+    }
+
+    snap = (GameSnapshot*) malloc(size);
+    if (! snap)
+        return NULL;
+
+    snap->size = size;
+    memcpy(snap->random, xu4.randomSim, sizeof(snap->random));
+    memcpy(snap->randomFx, xu4.randomFx, sizeof(snap->randomFx));
+    snap->lastShipLoc = -1;
+    snap->lastShipObj = 0;
+
+    snap->save = *ctx->saveGame;
+    ctx->party->getState(&snap->party);
+
+    {
+    SnapContext* sc = &snap->ctx;
+    sc->moonPhase        = ctx->moonPhase;
+    sc->windDirection    = ctx->windDirection;
+    sc->windCounter      = ctx->windCounter;
+    sc->horseSpeed       = ctx->horseSpeed;
+    sc->opacity          = ctx->opacity;
+    sc->transportContext = ctx->transportContext;
+    sc->lastCommandTime  = ctx->lastCommandTime;
+    sc->commandTimer     = ctx->commandTimer;
+    sc->aura             = ctx->aura;
+    sc->windLock         = ctx->windLock;
+    }
+
+    pos = ((uint8_t*) snap) + SNAP_PAD(sizeof(GameSnapshot));
+    locIndex = 0;
+    for (loc = ctx->location; loc; loc = loc->prev, ++locIndex) {
+        const Map* map = loc->map;
+        SnapLocation* sl = (SnapLocation*) pos;
+        size_t n;
+
+        sl->coords    = loc->coords;
+        sl->viewMode  = loc->viewMode;
+        sl->context   = loc->context;
+        sl->tileCount = mapTileCount(map);
+        sl->annoCount = map->annotations.size();
+        sl->objCount  = map->objects.size();
+        sl->mapId     = map->id;
+        pos += SNAP_PAD(sizeof(SnapLocation));
+
+        n = sl->tileCount * sizeof(TileId);
+        memcpy(pos, map->data, n);
+        pos += SNAP_PAD(n);
+
+        {
+        Annotation* anno = (Annotation*) pos;
+        AnnotationList::const_iterator it;
+        foreach (it, map->annotations)
+            *anno++ = *it;
+        pos += SNAP_PAD(sl->annoCount * sizeof(Annotation));
+        }
+
+        {
+        ObjectVector::const_iterator it;
+        int objIndex = 0;
+        foreach (it, map->objects) {
+            const Object* obj = *it;
+            SnapObject* so = (SnapObject*) pos;
+
+            n = SNAP_PAD(objectSize(obj->objType));
+            so->size = SNAP_PAD(sizeof(SnapObject)) + n;
+            so->objType = obj->objType;
+            copyObject(pos + SNAP_PAD(sizeof(SnapObject)), obj);
+            pos += so->size;
+
+            if (obj == ctx->lastShip) {
+                snap->lastShipLoc = locIndex;
+                snap->lastShipObj = objIndex;
+            }
+            ++objIndex;
+        }
+        }
+    }
+    snap->locCount = locIndex;
+
+    return snap;
+}
+
+/*
+ * Return the address of the record following a SnapLocation.
+ */
+static const uint8_t* skipLocation(const SnapLocation* sl) {
+    const uint8_t* pos = ((const uint8_t*) sl) +
+                         SNAP_PAD(sizeof(SnapLocation)) +
+                         SNAP_PAD(sl->tileCount * sizeof(TileId)) +
+                         SNAP_PAD(sl->annoCount * sizeof(Annotation));
+    for (uint32_t i = 0; i < sl->objCount; ++i)
+        pos += ((const SnapObject*) pos)->size;
+    return pos;
+}
+
+/**
+ * Replace the game simulation state with a snapshot.
+ *
+ * Only Location stacks which visit the same maps as when the snapshot was
+ * captured can be restored.  If the party has entered or left a map since
+ * then the game must be reloaded instead.
+ *
+ * No notifications are emitted; the caller should update the screen.
+ *
+ * \return Non-zero if successful or zero if the Location stack differs.
+ */
+int snapshot_restore(Context* ctx, const GameSnapshot* snap) {
+    const uint8_t* pos;
+    const SnapLocation* sl;
+    Location* loc;
+    uint32_t oi;
+    int locIndex;
+
+    // Verify that the Location stack matches.
+    pos = ((const uint8_t*) snap) + SNAP_PAD(sizeof(GameSnapshot));
+    locIndex = 0;
+    for (loc = ctx->location; loc; loc = loc->prev, ++locIndex) {
+        sl = (const SnapLocation*) pos;
+        if (locIndex >= snap->locCount || sl->mapId != loc->map->id ||
+            sl->tileCount != mapTileCount(loc->map))
+            return 0;
+        pos = skipLocation(sl);
+    }
+    if (locIndex != snap->locCount)
+        return 0;
+
+    *ctx->saveGame = snap->save;
+    ctx->party->restoreState(&snap->party);
+    ctx->lastShip = NULL;
+
+    {
+    const SnapContext* sc = &snap->ctx;
+    ctx->moonPhase        = sc->moonPhase;
+    ctx->windDirection    = sc->windDirection;
+    ctx->windCounter      = sc->windCounter;
+    ctx->horseSpeed       = sc->horseSpeed;
+    ctx->opacity          = sc->opacity;
+    ctx->transportContext = (TransportContext) sc->transportContext;
+    ctx->lastCommandTime  = sc->lastCommandTime;
+    ctx->commandTimer     = sc->commandTimer;
+    ctx->aura             = sc->aura;
+    ctx->windLock         = sc->windLock;
+    }
+
+    pos = ((const uint8_t*) snap) + SNAP_PAD(sizeof(GameSnapshot));
+    locIndex = 0;
+    for (loc = ctx->location; loc; loc = loc->prev, ++locIndex) {
+        Map* map = loc->map;
+        size_t n;
+
+        sl = (const SnapLocation*) pos;
+        loc->coords   = sl->coords;
+        loc->viewMode = sl->viewMode;
+        loc->context  = (LocationContext) sl->context;
+        pos += SNAP_PAD(sizeof(SnapLocation));
+
+        n = sl->tileCount * sizeof(TileId);
+        memcpy(map->data, pos, n);
+        pos += SNAP_PAD(n);
+
+        {
+        const Annotation* anno = (const Annotation*) pos;
+        map->annotations.assign(anno, anno + sl->annoCount);
+        pos += SNAP_PAD(sl->annoCount * sizeof(Annotation));
+        }
+
+        map->clearObjects();
+        for (oi = 0; oi < sl->objCount; ++oi) {
+            const SnapObject* so = (const SnapObject*) pos;
+            Object* obj = copyObject(NULL,
+                        (const Object*) (pos + SNAP_PAD(sizeof(SnapObject))));
+            Coords prev = obj->prevCoords;
+
+            obj->placeOnMap(map, obj->coords);
+            obj->prevCoords = prev;
+            map->objects.push_back(obj);
+
+            if (locIndex == snap->lastShipLoc && int(oi) == snap->lastShipObj)
+                ctx->lastShip = obj;
+            pos += so->size;
+        }
+    }
+
+    memcpy(xu4.randomSim, snap->random, sizeof(snap->random));
+    memcpy(xu4.randomFx, snap->randomFx, sizeof(xu4.randomFx));
+    return 1;
+}
+
+size_t snapshot_size(const GameSnapshot* snap) {
+    return snap->size;
+}
+
+void snapshot_free(GameSnapshot* snap) {
+    const SnapLocation* sl;
+    const uint8_t* pos;
+    uint32_t oi;
+
+    if (! snap)
+        return;
+
+    // Destroy the object copies.
+    pos = ((const uint8_t*) snap) + SNAP_PAD(sizeof(GameSnapshot));
+    for (int i = 0; i < snap->locCount; ++i) {
+        sl = (const SnapLocation*) pos;
+        pos = ((const uint8_t*) sl) + SNAP_PAD(sizeof(SnapLocation)) +
+              SNAP_PAD(sl->tileCount * sizeof(TileId)) +
+              SNAP_PAD(sl->annoCount * sizeof(Annotation));
+        for (oi = 0; oi < sl->objCount; ++oi) {
+            const SnapObject* so = (const SnapObject*) pos;
+            Object* obj = (Object*) (pos + SNAP_PAD(sizeof(SnapObject)));
+            obj->~Object();
+            pos += so->size;
+        }
+    }
+    free(snap);
+}
@@ -0,0 +1,18 @@
+/*
+ * snapshot.h
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+
+class Context;
+struct GameSnapshot;
+
+GameSnapshot* snapshot_capture(const Context*);
+int    snapshot_restore(Context*, const GameSnapshot*);
+size_t snapshot_size(const GameSnapshot*);
+void   snapshot_free(GameSnapshot*);
+
+#endif /* SNAPSHOT_H */
@@ -18,7 +18,7 @@ typedef struct {
     uint16_t animType;
     uint16_t state;
     uint16_t loops;
-    uint16_t _pad;
+    uint16_t activeIndex;   // Position in Animator::active.
     uint32_t finishId;
     float duration;
     float ctime;
@@ -43,6 +43,7 @@ AnimatedValue;
 
 #define FREE_TERM   0xffff
 #define NEXT_FREE   finishId
+#define ANIM_LIMIT  FREE_TERM
 
 static void anim_nopFinish(void* fdata, uint32_t fid)
 {
@@ -51,7 +52,27 @@ static void anim_nopFinish(void* fdata, uint32_t fid)
 }
 
 /*
- * Allocate memory for the specified maximum number of animated values.
+ * Link bank values from start to avail into the free list.
+ */
+static void anim_linkFree(Animator* an, uint32_t start)
+{
+    AnimatedValue* it = BANK(an) + start;
+    uint32_t end = an->avail - 1;
+    uint32_t i;
+
+    for (i = start; i < end; ++i) {
+        it->NEXT_FREE = i + 1;      // Point to next free value.
+        it->state = ANIM_FREE;
+        ++it;
+    }
+    it->NEXT_FREE = an->firstFree;
+    it->state = ANIM_FREE;
+    an->firstFree = start;
+}
+
+/*
+ * Allocate memory for the specified initial number of animated values.
+ * The bank is enlarged as needed when animations are started.
  *
  * Return non-zero if memory allocation is successful.
  */
@@ -61,7 +82,12 @@ int anim_init(Animator* an, int count, void (*finishFunc)(void*, uint32_t),
     an->finish = finishFunc ? finishFunc : anim_nopFinish;
     an->finishData = fdata;
     an->bank = malloc(sizeof(AnimatedValue) * count);
-    an->avail = an->bank ? count : 0;
+    an->active = (AnimId*) malloc(sizeof(AnimId) * count);
+    if (an->bank && an->active) {
+        an->avail = count;
+    } else {
+        anim_free(an);
+    }
     anim_clear(an);
     return an->avail;
 }
@@ -72,7 +98,9 @@ int anim_init(Animator* an, int count, void (*finishFunc)(void*, uint32_t),
 void anim_free(Animator* an)
 {
     free(an->bank);
+    free(an->active);
     an->bank = NULL;
+    an->active = NULL;
     an->avail = an->used = 0;
 }
 
@@ -81,52 +109,76 @@ void anim_free(Animator* an)
  */
 void anim_clear(Animator* an)
 {
-    an->used = an->firstFree = 0;
-    if (an->avail) {
-        AnimatedValue* it = BANK(an);
-        int end = an->avail - 1;
-        int i;
-
-        for (i = 1; i < end; ++i) {
-            it->NEXT_FREE = i;      // Point to next free value.
-            it->state = ANIM_FREE;
-            ++it;
-        }
-        it->NEXT_FREE = FREE_TERM;
-        it->state = ANIM_FREE;
+    an->used = 0;
+    an->firstFree = FREE_TERM;
+    if (an->avail)
+        anim_linkFree(an, 0);
+}
+
+/*
+ * Double the size of the bank.  Existing AnimIds remain valid.
+ *
+ * Return zero if the bank is at its limit or memory allocation fails.
+ */
+static int anim_grow(Animator* an)
+{
+    uint32_t count = an->avail ? an->avail * 2 : 16;
+    void* mem;
+
+    if (count > ANIM_LIMIT)
+        count = ANIM_LIMIT;
+    if (count <= an->avail)
+        return 0;
+
+    mem = realloc(an->active, sizeof(AnimId) * count);
+    if (! mem)
+        return 0;
+    an->active = (AnimId*) mem;
+
+    mem = realloc(an->bank, sizeof(AnimatedValue) * count);
+    if (! mem)
+        return 0;
+    an->bank = mem;
+
+    {
+    uint32_t start = an->avail;
+    an->avail = count;
+    anim_linkFree(an, start);
     }
+    return 1;
 }
 
 static AnimId anim_alloc(Animator* an)
 {
     AnimId id = an->firstFree;
-    if (id != FREE_TERM) {
-        an->firstFree = BANK(an)[id].NEXT_FREE;
-        if (id >= an->used)
-            an->used = id + 1;
+    if (id == FREE_TERM) {
+        if (! anim_grow(an))
+            return FREE_TERM;
+        id = an->firstFree;
     }
+    an->firstFree = BANK(an)[id].NEXT_FREE;
+
+    BANK(an)[id].activeIndex = an->used;
+    an->active[ an->used++ ] = id;
     return id;
 }
 
 static void anim_release(Animator* an, AnimatedValue* it)
 {
     AnimatedValue* bank = BANK(an);
-    int itPos, last;
+    AnimId moved;
+    int pos = it->activeIndex;
 
     it->state = ANIM_FREE;
 
     // Link into the free list.
     it->NEXT_FREE = an->firstFree;
-    an->firstFree = itPos = it - bank;
-
-    // Adjust used downward to the next active value.
-    last = an->used - 1;
-    if (itPos == last) {
-        do {
-            --last;
-        } while (last >= 0 && bank[last].state == ANIM_FREE);
-        an->used = last + 1;
-    }
+    an->firstFree = it - bank;
+
+    // Fill the hole in the active list with the last entry.
+    moved = an->active[ --an->used ];
+    an->active[pos] = moved;
+    bank[moved].activeIndex = pos;
 }
 
 static float lerp(float start, float end, float frac)
@@ -136,15 +188,19 @@ static float lerp(float start, float end, float frac)
 
 /*
  * Advance all playing animations by the given time.
+ * Only the animations which have been started and not yet released are
+ * visited.
  */
 void anim_advance(Animator* an, float seconds)
 {
-    AnimatedValue* it  = BANK(an);
-    AnimatedValue* end = it + an->used;
-    AnimatedValue* firstDone = NULL;
-    AnimatedValue* endDone = NULL;
+    AnimatedValue* bank = BANK(an);
+    AnimatedValue* it;
+    const AnimId* id  = an->active;
+    const AnimId* end = id + an->used;
+    int done = 0;
 
-    for ( ; it != end; ++it) {
+    for ( ; id != end; ++id) {
+        it = bank + *id;
         if (it->state == ANIM_PLAYING) {
             // Advance time.
             it->ctime += seconds;
@@ -159,9 +215,7 @@ void anim_advance(Animator* an, float seconds)
                         it->ctime -= it->duration;
                     } else {
                         it->state = ANIM_FINISHED;
-                        if (! firstDone)
-                            firstDone = it;
-                        endDone = it + 1;
+                        ++done;
                     }
                 }
 
@@ -196,16 +250,28 @@ void anim_advance(Animator* an, float seconds)
     }
 
     // Invoke the finish handler and release the slot for completed animations.
-    while (firstDone != endDone) {
-        // This iterates backwards so that the last released slot has the
-        // lowest firstFree index of the batch.  This sets up the next
-        // anim_alloc to produce a lower Animator::used value.
-
-        --endDone;
-        if (endDone->state == ANIM_FINISHED) {
-            if (endDone->finishId)
-                an->finish(an->finishData, endDone->finishId);
-            anim_release(an, endDone);
+    if (done) {
+        // This iterates backwards so that entries moved into a released
+        // position have already been checked.  The finish handler may start
+        // new animations (which can reallocate the bank) so the value is
+        // looked up by id each time.
+
+        uint32_t i = an->used;
+        AnimId fin;
+        while (i--) {
+            if (i >= an->used)
+                continue;
+            fin = an->active[i];
+            it = BANK(an) + fin;
+            if (it->state == ANIM_FINISHED) {
+                if (it->finishId)
+                    an->finish(an->finishData, it->finishId);
+                it = BANK(an) + fin;
+                if (it->state == ANIM_FINISHED)
+                    anim_release(an, it);
+                if (--done == 0)
+                    break;
+            }
         }
     }
 }
@@ -214,7 +280,6 @@ static void anim_stdInit(AnimatedValue* it, float dur, int loops, uint32_t fid)
 {
     it->state    = ANIM_PLAYING;
     it->loops    = loops;
-    it->_pad     = 0;
     it->finishId = fid;
     it->duration = dur;
     it->ctime    = 0.0f;
@@ -16,10 +16,11 @@ typedef uint16_t AnimId;
 
 typedef struct {
     void* bank;
+    AnimId* active;         // Ids of values which are not free.
     void (*finish)(void*, uint32_t);
     void* finishData;
-    uint32_t avail;
-    uint32_t used;
+    uint32_t avail;         // Number of values in bank.
+    uint32_t used;          // Number of ids in active.
     uint32_t firstFree;
 }
 Animator;
@@ -7,6 +7,7 @@
 #include <sys/timeb.h>
 #include <windows.h>
 #else
+#include <sched.h>
 #include <sys/time.h>
 #include <time.h>
 #endif
@@ -51,3 +52,52 @@ void msecSleep(uint32_t ms)
    nanosleep(&stime, 0);
 #endif
 }
+
+// Return microseconds from a monotonic clock with an arbitrary origin.
+int64_t usecTicks()
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+    if (! freq.QuadPart)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (int64_t) (count.QuadPart / freq.QuadPart) * 1000000 +
+           (count.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec*1000000 + ts.tv_nsec/1000;
+#else
+    struct timeval ts;
+    gettimeofday(&ts, NULL);
+    return (int64_t) ts.tv_sec*1000000 + ts.tv_usec;
+#endif
+}
+
+/*
+ * Sleep for approximately the given number of microseconds.
+ * The actual delay depends on the system scheduler and may be longer.
+ */
+void usecSleep(int64_t us)
+{
+#ifdef _WIN32
+    if (us >= 1000)
+        Sleep((DWORD) (us / 1000));
+#else
+   struct timespec stime;
+   stime.tv_sec  = us / 1000000;
+   stime.tv_nsec = (us - stime.tv_sec*1000000) * 1000;
+   nanosleep(&stime, 0);
+#endif
+}
+
+// Give up the processor to other threads without sleeping.
+void usecYield()
+{
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
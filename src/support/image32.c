@@ -16,6 +16,27 @@
 #include <stdio.h>
 #include "image32.h"
 
+/*
+ * SIMD row kernels.  SSE2 is always present on x86_64 but must be checked
+ * for at runtime on 32-bit x86.  NEON is assumed whenever the compiler
+ * targets it.  The scalar loops are used for any remaining pixels.
+ */
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define USE_SSE2
+#define SSE2_FUNC
+#define HAVE_SSE2()     1
+#elif defined(__GNUC__) && defined(__i386__)
+#include <emmintrin.h>
+#define USE_SSE2
+#define SSE2_FUNC       __attribute__((target("sse2")))
+#define HAVE_SSE2()     __builtin_cpu_supports("sse2")
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_NEON
+#endif
+
 /**
  * Intialize an image struct with pixels set to NULL and w & h to zero.
  */
@@ -72,6 +93,169 @@ int image32_duplicatePixels(Image32* dest, const Image32* src)
     return bytes;
 }
 
+static inline uint8_t MIX(int A, int B, int alpha)
+{
+    return (int8_t) (A + ((B - A) * alpha / 255));
+}
+
+#ifdef USE_SSE2
+SSE2_FUNC
+static void fillRow_sse2(uint32_t* dp, int count, uint32_t icol)
+{
+    __m128i col = _mm_set1_epi32((int) icol);
+    for (; count >= 4; count -= 4, dp += 4)
+        _mm_storeu_si128((__m128i*) dp, col);
+    while (count--)
+        *dp++ = icol;
+}
+
+/*
+ * Blend two pixels unpacked to 16-bit channels.  The quotient of the
+ * non-negative product t = |B - A| * alpha by 255 is computed exactly as
+ * (t + 1 + (t >> 8)) >> 8, then the sign is restored so the result matches
+ * the truncating division in MIX().
+ */
+SSE2_FUNC
+static inline __m128i blend2_sse2(__m128i d16, __m128i s16)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one  = _mm_set1_epi16(1);
+    __m128i alpha, diff, neg, t, q;
+
+    alpha = _mm_shufflelo_epi16(s16, _MM_SHUFFLE(3,3,3,3));
+    alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3,3,3,3));
+    diff  = _mm_sub_epi16(s16, d16);
+    neg   = _mm_cmpgt_epi16(zero, diff);
+    t = _mm_mullo_epi16(_mm_max_epi16(diff, _mm_sub_epi16(zero, diff)), alpha);
+    q = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(t, one),
+                                     _mm_srli_epi16(t, 8)), 8);
+    q = _mm_sub_epi16(_mm_xor_si128(q, neg), neg);
+    return _mm_add_epi16(d16, q);
+}
+
+SSE2_FUNC
+static int blendRow_sse2(uint32_t* dp, const uint32_t* sp, int count)
+{
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128i amask = _mm_set1_epi32((int) 0xff000000);
+    __m128i s, d, lo, hi;
+    int n = count & ~3;
+
+    for (count = n; count; count -= 4, dp += 4, sp += 4) {
+        s = _mm_loadu_si128((const __m128i*) sp);
+        d = _mm_loadu_si128((const __m128i*) dp);
+        lo = blend2_sse2(_mm_unpacklo_epi8(d, zero),
+                         _mm_unpacklo_epi8(s, zero));
+        hi = blend2_sse2(_mm_unpackhi_epi8(d, zero),
+                         _mm_unpackhi_epi8(s, zero));
+        d = _mm_packus_epi16(lo, hi);
+        d = _mm_or_si128(_mm_andnot_si128(amask, d), _mm_and_si128(amask, s));
+        _mm_storeu_si128((__m128i*) dp, d);
+    }
+    return n;
+}
+#endif
+
+#ifdef USE_NEON
+static void fillRow_neon(uint32_t* dp, int count, uint32_t icol)
+{
+    uint32x4_t col = vdupq_n_u32(icol);
+    for (; count >= 4; count -= 4, dp += 4)
+        vst1q_u32(dp, col);
+    while (count--)
+        *dp++ = icol;
+}
+
+/*
+ * See blend2_sse2() for how the truncating division by 255 is done.
+ */
+static int blendRow_neon(uint32_t* dp, const uint32_t* sp, int count)
+{
+    static const uint8_t alphaIndex[8] = { 3, 3, 3, 3, 7, 7, 7, 7 };
+    const uint8x8_t aidx  = vld1_u8(alphaIndex);
+    const uint8x8_t amask = vreinterpret_u8_u32(vdup_n_u32(0xff000000));
+    const uint16x8_t one  = vdupq_n_u16(1);
+    const int16x8_t zero  = vdupq_n_s16(0);
+    uint8x8_t s8;
+    int16x8_t d16, diff, q;
+    uint16x8_t t;
+    int n = count & ~1;
+
+    for (count = n; count; count -= 2, dp += 2, sp += 2) {
+        s8   = vld1_u8((const uint8_t*) sp);
+        d16  = vreinterpretq_s16_u16(vmovl_u8(vld1_u8((const uint8_t*) dp)));
+        diff = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(s8)), d16);
+        t = vmulq_u16(vreinterpretq_u16_s16(vabsq_s16(diff)),
+                      vmovl_u8(vtbl1_u8(s8, aidx)));
+        q = vreinterpretq_s16_u16(vshrq_n_u16(
+                vaddq_u16(vaddq_u16(t, one), vshrq_n_u16(t, 8)), 8));
+        d16 = vbslq_s16(vcltq_s16(diff, zero), vsubq_s16(d16, q),
+                                               vaddq_s16(d16, q));
+        vst1_u8((uint8_t*) dp, vbsl_u8(amask, s8, vqmovun_s16(d16)));
+    }
+    return n;
+}
+#endif
+
+/*
+ * Set count pixels to icol.
+ */
+static void fillRow(uint32_t* dp, int count, uint32_t icol)
+{
+#if defined(USE_SSE2)
+    if (HAVE_SSE2()) {
+        fillRow_sse2(dp, count, icol);
+        return;
+    }
+#elif defined(USE_NEON)
+    fillRow_neon(dp, count, icol);
+    return;
+#endif
+    while (count--)
+        *dp++ = icol;
+}
+
+/*
+ * Mix count src pixels into dest using the src alpha.
+ */
+static void blendRow(uint32_t* dest, const uint32_t* src, int count)
+{
+    uint8_t* dp;
+    const uint8_t* sp;
+    const uint8_t* send;
+    int alpha;
+
+#if defined(USE_SSE2)
+    if (HAVE_SSE2()) {
+        int n = blendRow_sse2(dest, src, count);
+        dest += n;
+        src  += n;
+        count -= n;
+    }
+#elif defined(USE_NEON)
+    {
+        int n = blendRow_neon(dest, src, count);
+        dest += n;
+        src  += n;
+        count -= n;
+    }
+#endif
+
+    dp = (uint8_t*) dest;
+    sp = (const uint8_t*) src;
+    send = (const uint8_t*) (src + count);
+    while( sp != send ) {
+        alpha = sp[3];
+        dp[0] = MIX(dp[0], sp[0], alpha);
+        dp[1] = MIX(dp[1], sp[1], alpha);
+        dp[2] = MIX(dp[2], sp[2], alpha);
+        dp[3] = alpha;
+
+        dp += 4;
+        sp += 4;
+    }
+}
+
 /**
  * Fill an entire image with the given color.
  */
@@ -83,8 +267,7 @@ void image32_fill(Image32* img, const RGBA* color)
 
     icol = *((uint32_t*) color);
 
-    while (dp != dend)
-        *dp++ = icol;
+    fillRow(dp, dend - dp, icol);
 }
 
 /**
@@ -94,8 +277,6 @@ void image32_fillRect(Image32* img, int x, int y, int rw, int rh,
                       const RGBA* color)
 {
     uint32_t icol;
-    uint32_t* dp;
-    uint32_t* dend;
     uint32_t* drow = img->pixels + img->w * y + x;
 
     icol = *((uint32_t*) color);
@@ -111,19 +292,11 @@ void image32_fillRect(Image32* img, int x, int y, int rw, int rh,
         return;
 
     while (rh--) {
-        dp = drow;
-        dend = dp + rw;
-        while( dp != dend )
-            *dp++ = icol;
+        fillRow(drow, rw, icol);
         drow += img->w;
     }
 }
 
-static inline uint8_t MIX(int A, int B, int alpha)
-{
-    return (int8_t) (A + ((B - A) * alpha / 255));
-}
-
 /**
  * Draw one image onto another.
  *
@@ -143,7 +316,7 @@ void image32_blit(Image32* dest, int dx, int dy, const Image32* src, int blend)
         blitW += dx;     // Subtracts from blitW.
         dx = 0;
     }
-    else if ((blitW + dx) > (int) dest->w) {
+    if ((blitW + dx) > (int) dest->w) {
         blitW = dest->w - dx;
     }
     if (blitW < 1)
@@ -155,7 +328,7 @@ void image32_blit(Image32* dest, int dx, int dy, const Image32* src, int blend)
         blitH += dy;     // Subtracts from blitH.
         dy = 0;
     }
-    else if ((blitH + dy) > (int) dest->h) {
+    if ((blitH + dy) > (int) dest->h) {
         blitH = dest->h - dy;
     }
     if (blitH < 1)
@@ -164,39 +337,14 @@ void image32_blit(Image32* dest, int dx, int dy, const Image32* src, int blend)
     drow = dest->pixels + dest->w * dy + dx;
 
     if (blend) {
-        uint8_t* dp;
-        const uint8_t* sp;
-        const uint8_t* send;
-        int alpha;
-
         while (blitH--) {
-            dp = (uint8_t*) drow;
-            sp = (const uint8_t*) srow;
-            send = (const uint8_t*) (srow + blitW);
-            while( sp != send ) {
-                alpha = sp[3];
-                dp[0] = MIX(dp[0], sp[0], alpha);
-                dp[1] = MIX(dp[1], sp[1], alpha);
-                dp[2] = MIX(dp[2], sp[2], alpha);
-                dp[3] = alpha;
-
-                dp += 4;
-                sp += 4;
-            }
+            blendRow(drow, srow, blitW);
             drow += dest->w;
             srow += src->w;
         }
     } else {
-        uint32_t* dp;
-        const uint32_t* sp;
-        const uint32_t* send;
-
         while (blitH--) {
-            dp = drow;
-            sp = srow;
-            send = sp + blitW;
-            while( sp != send )
-                *dp++ = *sp++;
+            memmove(drow, srow, blitW * sizeof(uint32_t));
             drow += dest->w;
             srow += src->w;
         }
@@ -243,45 +391,45 @@ void image32_blitRect(Image32* dest, int dx, int dy,
     drow = dest->pixels + dest->w * dy + dx;
 
     if (blend) {
-        uint8_t* dp;
-        const uint8_t* sp;
-        const uint8_t* send;
-        int alpha;
-
         while (sh--) {
-            dp = (uint8_t*) drow;
-            sp = (const uint8_t*) srow;
-            send = (const uint8_t*) (srow + sw);
-            while( sp != send ) {
-                alpha = sp[3];
-                dp[0] = MIX(dp[0], sp[0], alpha);
-                dp[1] = MIX(dp[1], sp[1], alpha);
-                dp[2] = MIX(dp[2], sp[2], alpha);
-                dp[3] = alpha;
-
-                dp += 4;
-                sp += 4;
-            }
+            blendRow(drow, srow, sw);
             drow += dest->w;
             srow += src->w;
         }
     } else {
-        uint32_t* dp;
-        const uint32_t* sp;
-        const uint32_t* send;
-
         while (sh--) {
-            dp = drow;
-            sp = srow;
-            send = sp + sw;
-            while( sp != send )
-                *dp++ = *sp++;
+            memmove(drow, srow, sw * sizeof(uint32_t));
             drow += dest->w;
             srow += src->w;
         }
     }
 }
 
+/**
+ * Draw a sub-rectangle of one image onto another, flipped vertically.
+ * No blending is done.
+ */
+void image32_blitRectInverted(Image32* dest, int dx, int dy,
+                              const Image32* src, int sx, int sy,
+                              int sw, int sh)
+{
+    uint32_t* drow;
+    const uint32_t* srow;
+
+    // Clip position and source rect to positive values.
+    CLIP_SUB(dx, sx, sw, src->w, dest->w)
+    CLIP_SUB(dy, sy, sh, src->h, dest->h)
+
+    srow = src->pixels + src->w * (sy + sh - 1) + sx;
+    drow = dest->pixels + dest->w * dy + dx;
+
+    while (sh--) {
+        memmove(drow, srow, sw * sizeof(uint32_t));
+        drow += dest->w;
+        srow -= src->w;
+    }
+}
+
 #if 0
 /**
  * Load an image from a PPM file.
@@ -7,6 +7,15 @@
 #include <stdlib.h>
 #include "notify.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#define atomicOr(ptr,val)   _InterlockedOr((volatile long*) (ptr), val)
+#define atomicTake(ptr)     (uint32_t) _InterlockedExchange((volatile long*) (ptr), 0)
+#else
+#define atomicOr(ptr,val)   __atomic_fetch_or(ptr, val, __ATOMIC_RELEASE)
+#define atomicTake(ptr)     __atomic_exchange_n(ptr, 0, __ATOMIC_ACQUIRE)
+#endif
+
 struct NotifyListener {
     NotifyHandler func;
     void* user;
@@ -18,6 +27,7 @@ void notify_init(NotifyBus* bus, int listenerLimit)
     bus->list  = calloc(listenerLimit, sizeof(struct NotifyListener));
     bus->avail = bus->list ? listenerLimit : 0;
     bus->used  = 0;
+    bus->pending = 0;
 }
 
 void notify_free(NotifyBus* bus)
@@ -27,6 +37,7 @@ void notify_free(NotifyBus* bus)
         bus->list = NULL;
     }
     bus->avail = bus->used = 0;
+    bus->pending = 0;
 }
 
 /*
@@ -94,3 +105,30 @@ void notify_emit(const NotifyBus* bus, int senderId, void* message)
             it->func(senderId, message, it->user);
     }
 }
+
+/*
+  Queue a message without data for the next notify_dispatch().  All posts
+  from a sender between dispatches are delivered as one message, so this
+  suits "something changed" notices which would otherwise repeat many
+  times per frame.  This is lock-free and may be called from any thread.
+
+  \param senderId   User defined identifier from 0-31.
+*/
+void notify_post(NotifyBus* bus, int senderId)
+{
+    atomicOr(&bus->pending, 1u << senderId);
+}
+
+/*
+  Deliver posted messages to the listeners with a NULL message pointer.
+  This must be called from the thread which uses notify_emit().
+*/
+void notify_dispatch(NotifyBus* bus)
+{
+    uint32_t pending = atomicTake(&bus->pending);
+    int id;
+    for (id = 0; pending; ++id, pending >>= 1) {
+        if (pending & 1)
+            notify_emit(bus, id, NULL);
+    }
+}
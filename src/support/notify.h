@@ -14,6 +14,7 @@ typedef struct {
     struct NotifyListener* list;
     int avail;
     int used;
+    uint32_t pending;       // Sender mask of posted messages.
 }
 NotifyBus;
 
@@ -26,6 +27,8 @@ void notify_free(NotifyBus*);
 int  notify_listen(NotifyBus*, uint32_t senderMask, NotifyHandler, void* user);
 void notify_unplug(NotifyBus*, int listenerId);
 void notify_emit(const NotifyBus*, int senderId, void* message);
+void notify_post(NotifyBus*, int senderId);
+void notify_dispatch(NotifyBus*);
 
 #ifdef __cplusplus
 }
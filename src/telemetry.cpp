@@ -0,0 +1,215 @@
+/*
+ * telemetry.cpp
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "error.h"
+#include "image32.h"
+#include "gpu.h"
+#include "screen.h"
+#include "telemetry.h"
+#include "xu4.h"
+
+#define TELE_HISTORY    256     // Frames kept for percentiles (power of 2).
+#define TELE_REFRESH    30      // Frames between overlay text updates.
+#define TELE_ROW_CHARS  40      // Maximum glyphs per overlay row.
+
+static const char* zoneNames[TZ_COUNT] = {
+    "input", "timers", "moveObjects", "screenUpdate",
+    "drawMap", "upload", "swap", "frame"
+};
+
+struct Telemetry {
+    FILE* csv;
+    int64_t frameEnd;                       // Time of last tele_frameEnd().
+    uint32_t frame;                         // Number of frames recorded.
+    uint32_t refresh;                       // Frames until overlay update.
+    int32_t  acc[TZ_COUNT];                 // Usec accumulated this frame.
+    int32_t  hist[TZ_COUNT][TELE_HISTORY];  // Usec for recent frames.
+};
+
+/**
+ * Begin collecting frame timing.
+ *
+ * \param csvFile   If not NULL, each frame is written to this file as a
+ *                  line of comma separated zone times in microseconds.
+ */
+Telemetry* tele_create(const char* csvFile) {
+    Telemetry* tel = (Telemetry*) calloc(1, sizeof(Telemetry));
+
+    if (csvFile) {
+        tel->csv = fopen(csvFile, "w");
+        if (tel->csv) {
+            fprintf(tel->csv, "frame");
+            for (int i = 0; i < TZ_COUNT; ++i)
+                fprintf(tel->csv, ",%s", zoneNames[i]);
+            fprintf(tel->csv, "\n");
+        } else
+            errorWarning("Cannot open telemetry file %s", csvFile);
+    }
+
+    tel->frameEnd = usecTicks();
+    return tel;
+}
+
+void tele_free(Telemetry* tel) {
+    if (tel) {
+        if (tel->csv)
+            fclose(tel->csv);
+        free(tel);
+    }
+}
+
+/**
+ * Add time to a zone of the current frame.
+ */
+void tele_add(Telemetry* tel, int zone, int64_t usec) {
+    tel->acc[zone] += (int32_t) usec;
+}
+
+/**
+ * Add the time from start (or the end of the last frame if that is later)
+ * until now to a zone of the current frame.
+ */
+void tele_addSince(Telemetry* tel, int zone, int64_t start) {
+    if (start < tel->frameEnd)
+        start = tel->frameEnd;
+    tel->acc[zone] += (int32_t) (usecTicks() - start);
+}
+
+/**
+ * Record the zone times accumulated since the last call and reset them.
+ * This should be called once after each frame is presented.
+ */
+void tele_frameEnd(Telemetry* tel) {
+    int n = tel->frame & (TELE_HISTORY - 1);
+    int i;
+
+    for (i = 0; i < TZ_COUNT; ++i)
+        tel->hist[i][n] = tel->acc[i];
+
+    if (tel->csv) {
+        fprintf(tel->csv, "%u", tel->frame);
+        for (i = 0; i < TZ_COUNT; ++i)
+            fprintf(tel->csv, ",%d", tel->acc[i]);
+        fprintf(tel->csv, "\n");
+    }
+
+    memset(tel->acc, 0, sizeof(tel->acc));
+    ++tel->frame;
+    tel->frameEnd = usecTicks();
+}
+
+/*
+ * Compute the 50th, 95th & 99th percentile (in milliseconds) of a zone
+ * over the recorded history.
+ */
+static void tele_percentiles(const Telemetry* tel, int zone, float* pct) {
+    int32_t sorted[TELE_HISTORY];
+    int count = std::min(tel->frame, (uint32_t) TELE_HISTORY);
+
+    if (! count) {
+        pct[0] = pct[1] = pct[2] = 0.0f;
+        return;
+    }
+
+    memcpy(sorted, tel->hist[zone], count * sizeof(int32_t));
+    std::sort(sorted, sorted + count);
+
+    --count;
+    pct[0] = sorted[count * 50 / 100] * 0.001f;
+    pct[1] = sorted[count * 95 / 100] * 0.001f;
+    pct[2] = sorted[count * 99 / 100] * 0.001f;
+}
+
+static float* emitText(float* attr, TxfDrawState* ds, float x, float y,
+                       const char* text) {
+    int quadCount;
+
+    ds->x = x;
+    ds->y = y;
+    quadCount = txf_genText(ds, attr + 3, attr, GPU_VERT_ATTR_LEN,
+                            (const uint8_t*) text, strlen(text));
+    return attr + (quadCount * 4 * GPU_VERT_ATTR_LEN);
+}
+
+/*
+ * Generate the overlay table of zone percentiles in the upper left corner
+ * of the screen.
+ */
+static void tele_layoutOverlay(const Telemetry* tel, const ScreenState* ss) {
+    static const char* header[4] = { "msec", "p50", "p95", "p99" };
+    TxfDrawState ds;
+    float rect[4];
+    float uvs[4];
+    float pct[3];
+    float colX[4];
+    float psize, lineH, x, y;
+    char num[16];
+    float* attr;
+    int i, j;
+
+    psize = 12.0f * ss->aspectH / 480.0f;
+    ds.fontTable = ss->fontTable;
+    txf_begin(&ds, 0, psize, 0.0f, 0.0f);
+    ds.emitTris = 0;    // Emit quads.
+    lineH = ds.lineSpacing;
+
+    x = psize * 0.5f;
+    colX[0] = x + psize * 0.5f;
+    colX[1] = colX[0] + psize * 7.5f;
+    colX[2] = colX[1] + psize * 3.5f;
+    colX[3] = colX[2] + psize * 3.5f;
+
+    rect[2] = colX[3] + psize * 3.5f - x;
+    rect[3] = lineH * (TZ_COUNT + 1) + psize * 0.5f;
+    rect[0] = x;
+    rect[1] = ss->aspectH - x - rect[3];
+
+    attr = gpu_beginTris(xu4.gpu, GPU_DLIST_OVERLAY,
+                         1 + (TZ_COUNT + 1) * TELE_ROW_CHARS);
+
+    gpu_guiClutUV(xu4.gpu, uvs, 128.0f);
+    uvs[2] = uvs[0];
+    uvs[3] = uvs[1];
+    attr = gpu_emitQuad(attr, rect, uvs);
+
+    y = rect[1] + rect[3] - lineH + ds.tf->descender * psize;
+    for (j = 0; j < 4; ++j)
+        attr = emitText(attr, &ds, colX[j], y, header[j]);
+
+    for (i = 0; i < TZ_COUNT; ++i) {
+        y -= lineH;
+        attr = emitText(attr, &ds, colX[0], y, zoneNames[i]);
+
+        tele_percentiles(tel, i, pct);
+        for (j = 0; j < 3; ++j) {
+            snprintf(num, sizeof(num), "%.2f", pct[j]);
+            attr = emitText(attr, &ds, colX[j+1], y, num);
+        }
+    }
+
+    gpu_endTris(xu4.gpu, GPU_DLIST_OVERLAY, attr);
+}
+
+/**
+ * Render layer function to draw the telemetry overlay.
+ */
+void tele_render(ScreenState* ss, void* data) {
+    Telemetry* tel = (Telemetry*) data;
+
+    if (! ss->fontTable)
+        return;
+
+    if (! tel->refresh) {
+        tel->refresh = TELE_REFRESH;
+        tele_layoutOverlay(tel, ss);
+    }
+    --tel->refresh;
+
+    gpu_drawGui(xu4.gpu, GPU_DLIST_OVERLAY);
+}
@@ -0,0 +1,57 @@
+/*
+ * telemetry.h
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+enum TelemetryZone {
+    TZ_INPUT,           // EventHandler::handleInputEvents
+    TZ_TIMERS,          // TimedEventMgr::tick
+    TZ_MOVE_OBJECTS,    // Map::moveObjects
+    TZ_SCREEN_UPDATE,   // screenUpdate
+    TZ_DRAW_MAP,        // gpu_drawMap
+    TZ_UPLOAD,          // screenImage texture upload
+    TZ_SWAP,            // screenSwapBuffers
+    TZ_FRAME,           // Time between presented frames
+
+    TZ_COUNT
+};
+
+struct Telemetry;
+struct ScreenState;
+
+Telemetry* tele_create(const char* csvFile);
+void tele_free(Telemetry*);
+void tele_add(Telemetry*, int zone, int64_t usec);
+void tele_addSince(Telemetry*, int zone, int64_t start);
+void tele_frameEnd(Telemetry*);
+void tele_render(ScreenState*, void* data);
+
+extern int64_t usecTicks();
+
+/*
+ * Scoped timer which adds the time spent in the enclosing block to a zone.
+ * Nothing is measured if tel is NULL.
+ *
+ * Blocks may run nested event loops (e.g. EventHandler::wait_msecs), so
+ * only the time since the last presented frame is counted.
+ */
+struct TelemetryScope {
+    TelemetryScope(Telemetry* tel, int zone)
+        : tel(tel), start(tel ? usecTicks() : 0), zone(zone) {}
+    ~TelemetryScope() {
+        if (tel)
+            tele_addSince(tel, zone, start);
+    }
+
+    Telemetry* tel;
+    int64_t start;
+    int zone;
+};
+
+#define TELE_SCOPE(zone)    TelemetryScope teleScope_(xu4.telemetry, zone)
+
+#endif /* TELEMETRY_H */
@@ -2,6 +2,7 @@
  * tileanim.cpp
  */
 
+#include <cstring>
 #include "config.h"
 #include "image.h"
 #include "screen.h"
@@ -121,6 +122,166 @@ void TileAnimTransform::draw(Image* dest, const Tile* tile,
 
 //--------------------------------------
 
+#define PCOLOR_FRAMES   8
+
+/*
+ * Transform frames prebaked for a tile image so that drawing only needs to
+ * copy pixels.
+ *
+ * ATYPE_SCROLL stores each tile frame twice in a vertical strip so that any
+ * scroll offset is a single sub-image.
+ *
+ * ATYPE_PIXEL_COLOR stores the positions of the pixels in the color range
+ * and PCOLOR_FRAMES random colors for each one.
+ */
+struct TileAnimCache {
+    const TileAnimTransform* transform;
+    const Image* source;                // Tile image the cache was made from.
+    Image* strip;
+    std::vector<uint32_t> pixelStart;   // First pixel index of each frame.
+    std::vector<uint16_t> pixelPos;     // X,Y of each changing pixel.
+    std::vector<uint32_t> pixelColor;   // PCOLOR_FRAMES colors per pixel.
+
+    TileAnimCache() : strip(NULL) {}
+    ~TileAnimCache() { delete strip; }
+};
+
+static void bakeScroll(TileAnimCache* ac, const Tile* tile)
+{
+    const Image* img = tile->getImage();
+    int w = tile->getWidth();
+    int h = tile->getHeight();
+    int frames = tile->getFrames();
+    int wasBlending = Image::enableBlend(0);
+
+    ac->strip = Image::create(w, h * 2 * frames);
+    for (int f = 0; f < frames; ++f) {
+        img->drawSubRectOn(ac->strip, 0, f * 2 * h,     0, f * h, w, h);
+        img->drawSubRectOn(ac->strip, 0, f * 2 * h + h, 0, f * h, w, h);
+    }
+
+    Image::enableBlend(wasBlending);
+}
+
+static void bakePixelColor(TileAnimCache* ac, const TileAnimTransform* tf,
+                           const Tile* tile)
+{
+    const Image* img = tile->getImage();
+    int x = tf->var.pcolor.x;
+    int y = tf->var.pcolor.y;
+    int w = tf->var.pcolor.w;
+    int h = tf->var.pcolor.h;
+    RGBA start = tf->var.pcolor.start;
+    RGBA end   = tf->var.pcolor.end;
+    RGBA diff  = end;
+    RGBA col;
+
+    diff.r -= start.r;
+    diff.g -= start.g;
+    diff.b -= start.b;
+
+    for (int f = 0; f < tile->getFrames(); ++f) {
+        ac->pixelStart.push_back(ac->pixelPos.size() / 2);
+
+        for (int j = y; j < y + h; j++) {
+            for (int i = x; i < x + w; i++) {
+                RGBA pixelAt;
+                img->getPixel(i, j + (f * tile->getHeight()), pixelAt);
+                if (pixelAt.r >= start.r && pixelAt.r <= end.r &&
+                    pixelAt.g >= start.g && pixelAt.g <= end.g &&
+                    pixelAt.b >= start.b && pixelAt.b <= end.b) {
+                    ac->pixelPos.push_back(i);
+                    ac->pixelPos.push_back(j);
+                    for (int n = 0; n < PCOLOR_FRAMES; ++n) {
+                        uint32_t u32;
+                        rgba_set(col, start.r + xu4_randomFx(diff.r),
+                                      start.g + xu4_randomFx(diff.g),
+                                      start.b + xu4_randomFx(diff.b),
+                                      pixelAt.a);
+                        memcpy(&u32, &col, sizeof(u32));
+                        ac->pixelColor.push_back(u32);
+                    }
+                }
+            }
+        }
+    }
+    ac->pixelStart.push_back(ac->pixelPos.size() / 2);
+}
+
+/*
+ * Return the prebaked frames of a transform for the tile image, or NULL
+ * if the transform type is not cached.
+ */
+static const TileAnimCache* transformCache(std::vector<TileAnimCache*>& caches,
+                                           const TileAnimTransform* tf,
+                                           const Tile* tile)
+{
+    const Image* source = tile->getImage();
+    std::vector<TileAnimCache*>::iterator it;
+    TileAnimCache* ac;
+
+    if (tf->animType != ATYPE_SCROLL && tf->animType != ATYPE_PIXEL_COLOR)
+        return NULL;
+    if (! source)
+        return NULL;
+
+    foreach (it, caches) {
+        ac = *it;
+        if (ac->transform == tf && ac->source == source)
+            return ac;
+    }
+
+    ac = new TileAnimCache;
+    ac->transform = tf;
+    ac->source = source;
+    if (tf->animType == ATYPE_SCROLL)
+        bakeScroll(ac, tile);
+    else
+        bakePixelColor(ac, tf, tile);
+    caches.push_back(ac);
+    return ac;
+}
+
+/*
+ * Draw a transform using prebaked frames.
+ */
+static void drawCached(TileAnimTransform* tf, const TileAnimCache* ac,
+                       Image* dest, const Tile* tile, const MapTile& mapTile)
+{
+    int th = tile->getHeight();
+
+    if (tf->animType == ATYPE_SCROLL) {
+        if (tf->var.scroll.increment == 0)
+            tf->var.scroll.increment = 1;
+
+        int offset = screenState()->currentCycle * 4 / SCR_CYCLE_PER_SECOND;
+        if (tf->var.scroll.lastOffset != offset) {
+            tf->var.scroll.lastOffset = offset;
+            tf->var.scroll.current += tf->var.scroll.increment;
+            if (tf->var.scroll.current >= th)
+                tf->var.scroll.current = 0;
+        }
+
+        int sy = mapTile.frame * 2 * th + (th - tf->var.scroll.current) % th;
+        ac->strip->drawSubRectOn(dest, 0, 0, 0, sy, tile->getWidth(), th);
+    } else {
+        uint32_t* pixels = dest->pixels;
+        const uint16_t* pos;
+        const uint32_t* color;
+        uint32_t p   = ac->pixelStart[ mapTile.frame ];
+        uint32_t end = ac->pixelStart[ mapTile.frame + 1 ];
+
+        pos   = ac->pixelPos.data() + p * 2;
+        color = ac->pixelColor.data() + p * PCOLOR_FRAMES +
+                xu4_randomFx(PCOLOR_FRAMES);
+        for (; p != end; ++p) {
+            pixels[ pos[1] * dest->w + pos[0] ] = *color;
+            pos += 2;
+            color += PCOLOR_FRAMES;
+        }
+    }
+}
+
 TileAnim::~TileAnim()
 {
 #ifndef USE_BORON
@@ -128,6 +289,9 @@ TileAnim::~TileAnim()
     foreach (ti, transforms)
         delete *ti;
 #endif
+    std::vector<TileAnimCache *>::iterator ci;
+    foreach (ci, caches)
+        delete *ci;
 }
 
 static bool drawsTile(const TileAnimTransform* tf)
@@ -164,7 +328,11 @@ void TileAnim::draw(Image *dest, const Tile *tile, const MapTile &mapTile, Direc
                         mapTile.frame * tile->getHeight(),
                         tile->getWidth(), tile->getHeight());
             }
-            trans->draw(dest, tile, mapTile);
+            const TileAnimCache* ac = transformCache(caches, trans, tile);
+            if (ac)
+                drawCached(trans, ac, dest, tile, mapTile);
+            else
+                trans->draw(dest, tile, mapTile);
             drawn = true;
         }
     }
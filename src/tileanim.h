@@ -13,6 +13,7 @@
 class Image;
 class Tile;
 struct RGBA;
+struct TileAnimCache;
 
 enum TileAnimType {
     ATYPE_INVERT,
@@ -95,6 +96,7 @@ public:
     void draw(Image *dest, const Tile *tile, const MapTile &mapTile, Direction dir);
 
     std::vector<TileAnimTransform *> transforms;
+    std::vector<TileAnimCache *> caches;    // Prebaked transform frames.
     Symbol name;
     int16_t random;     /* Non-zero if the animation occurs randomly */
 };
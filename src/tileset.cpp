@@ -2,7 +2,10 @@
  * tileset.cpp
  */
 
+#include <cstdlib>
 #include <cstring>
+#include <map>
+#include <vector>
 #include "tileset.h"
 
 #include "error.h"
@@ -66,7 +69,15 @@ void Tileset::loadImages() {
 #else
         Tile* it  = ts->tiles;
         Tile* end = it + ts->tileCount;
+
+        // Decode the source images in parallel before extracting the tiles.
+        std::vector<Symbol> names;
+        names.reserve(ts->tileCount);
         for (; it != end; ++it)
+            names.push_back(it->imageName);
+        xu4.imageMgr->preload(names.data(), names.size());
+
+        for (it = ts->tiles; it != end; ++it)
             it->loadImage();
 #endif
     }
@@ -98,7 +109,7 @@ const Tile* Tileset::findTileById(TileId id) {
     return xu4.config->tileset()->get(id);
 }
 
-Tileset::Tileset(int count) : tileCount(0) {
+Tileset::Tileset(int count) : tileCount(0), nameCount(0), nameIndex(NULL) {
     tiles  = new Tile[count];
     render = new TileRenderData[count];
     memset(tiles, 0, sizeof(Tile) * count);
@@ -107,6 +118,7 @@ Tileset::Tileset(int count) : tileCount(0) {
 Tileset::~Tileset() {
     delete[] tiles;
     delete[] render;
+    free(nameIndex);
 }
 
 /**
@@ -119,11 +131,22 @@ const Tile* Tileset::get(TileId id) const {
 }
 
 /**
- * Returns the tile with the given name from the tileset, if it exists
+ * Make a tile available from getByName().
+ *
+ * Symbols are small integers so the index is a plain array; this keeps
+ * name lookups (done from combat & map code every turn) to a bounds check
+ * and a load.
  */
-const Tile* Tileset::getByName(Symbol name) const {
-    TileNameMap::const_iterator it = nameMap.find(name);
-    if (it != nameMap.end())
-        return it->second;
-    return NULL;
+void Tileset::setName(Symbol name, const Tile* tile) {
+    if (name >= nameCount) {
+        uint32_t count = (name + 64) & ~63;
+        const Tile** index =
+            (const Tile**) realloc(nameIndex, count * sizeof(Tile*));
+        if (! index)
+            errorFatal("Tileset::setName: out of memory");
+        memset(index + nameCount, 0, (count - nameCount) * sizeof(Tile*));
+        nameIndex = index;
+        nameCount = count;
+    }
+    nameIndex[name] = tile;
 }
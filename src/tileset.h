@@ -5,7 +5,6 @@
 #ifndef TILESET_H
 #define TILESET_H
 
-#include <map>
 #include "tile.h"
 
 /**
@@ -13,8 +12,6 @@
  */
 class Tileset {
 public:
-    typedef std::map<Symbol, const Tile*> TileNameMap;
-
     static void loadImages();
     static void unloadImages();
     static const Tile* findTileByName(Symbol name);
@@ -24,12 +21,20 @@ public:
     ~Tileset();
 
     const Tile* get(TileId id) const;
-    const Tile* getByName(Symbol name) const;
+    void setName(Symbol name, const Tile* tile);
+
+    /**
+     * Returns the tile with the given name from the tileset, if it exists
+     */
+    const Tile* getByName(Symbol name) const {
+        return (name < nameCount) ? nameIndex[name] : NULL;
+    }
 
     Tile* tiles;
     TileRenderData* render;
     uint32_t tileCount;
-    TileNameMap nameMap;
+    uint32_t nameCount;
+    const Tile** nameIndex;     // Tile for each Symbol (or NULL).
 };
 
 #endif
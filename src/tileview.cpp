@@ -300,7 +300,7 @@ void TileView::updateEffects(float cx, float cy, const float* uvTable) {
         const float VIEW_TILE_SIZE = 1.0f;
         const Animator* fxAnim = &xu4.eventHandler->fxAnim;
         float* animPos;
-        float* attr = gpu_beginTris(xu4.gpu, GPU_DLIST_VIEW_FX);
+        float* attr = gpu_beginTris(xu4.gpu, GPU_DLIST_VIEW_FX, effectCount);
         float rect[4];
         int uvIndex;
         VisualEffect* it = effect;
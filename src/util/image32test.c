@@ -0,0 +1,118 @@
+/*
+ * image32test.c
+ *
+ * Check that the SIMD row kernels of image32.c produce exactly the same
+ * bytes as the scalar reference code.
+ */
+
+#include <stdlib.h>
+#include "../support/image32.c"
+
+#define ROW_MAX     67      // Covers every tail length of the 4 pixel loops.
+#define ROW_TRIALS  20000
+
+static uint32_t rng = 0x2545f491;
+
+static uint32_t randU32(void)
+{
+    // xorshift32
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static void blendRowRef(uint32_t* dest, const uint32_t* src, int count)
+{
+    uint8_t* dp = (uint8_t*) dest;
+    const uint8_t* sp = (const uint8_t*) src;
+    int alpha;
+
+    for (; count; --count, dp += 4, sp += 4) {
+        alpha = sp[3];
+        dp[0] = MIX(dp[0], sp[0], alpha);
+        dp[1] = MIX(dp[1], sp[1], alpha);
+        dp[2] = MIX(dp[2], sp[2], alpha);
+        dp[3] = alpha;
+    }
+}
+
+static void fillRowRef(uint32_t* dp, int count, uint32_t icol)
+{
+    while (count--)
+        *dp++ = icol;
+}
+
+/*
+ * Return the number of mismatched rows.
+ */
+static int testRandomRows(void)
+{
+    // One extra pixel on each side to catch writes outside the row and an
+    // offset so the rows are not always 16 byte aligned.
+    uint32_t src[ROW_MAX + 4];
+    uint32_t dst[ROW_MAX + 4];
+    uint32_t ref[ROW_MAX + 4];
+    uint32_t col;
+    int i, n, off, width, fail = 0;
+
+    for (i = 0; i < ROW_TRIALS; ++i) {
+        width = i % (ROW_MAX + 1);
+        off = 1 + (randU32() & 1);
+        for (n = 0; n < ROW_MAX + 4; ++n) {
+            src[n] = randU32();
+            dst[n] = ref[n] = randU32();
+        }
+
+        blendRow(dst + off, src + off, width);
+        blendRowRef(ref + off, src + off, width);
+        if (memcmp(dst, ref, sizeof(dst))) {
+            fprintf(stderr, "blendRow mismatch (width %d)\n", width);
+            ++fail;
+        }
+
+        col = randU32();
+        fillRow(dst + off, width, col);
+        fillRowRef(ref + off, width, col);
+        if (memcmp(dst, ref, sizeof(dst))) {
+            fprintf(stderr, "fillRow mismatch (width %d)\n", width);
+            ++fail;
+        }
+    }
+    return fail;
+}
+
+/*
+ * Blend every (dest, src, alpha) channel combination.
+ * Return the number of mismatched rows.
+ */
+static int testAllValues(void)
+{
+    uint32_t src[256];
+    uint32_t dst[256];
+    uint32_t ref[256];
+    int s, a, d, fail = 0;
+
+    for (a = 0; a < 256; ++a) {
+        for (s = 0; s < 256; ++s) {
+            for (d = 0; d < 256; ++d) {
+                src[d] = a << 24 | s << 16 | s << 8 | s;
+                dst[d] = ref[d] = 0xff000000 | d << 16 | d << 8 | d;
+            }
+            blendRow(dst, src, 256);
+            blendRowRef(ref, src, 256);
+            if (memcmp(dst, ref, sizeof(dst))) {
+                fprintf(stderr, "blendRow mismatch (src %d alpha %d)\n", s, a);
+                ++fail;
+            }
+        }
+    }
+    return fail;
+}
+
+int main(void)
+{
+    int fail = testRandomRows() + testAllValues();
+    printf("image32test: %s\n", fail ? "FAILED" : "passed");
+    return fail ? 1 : 0;
+}
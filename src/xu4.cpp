@@ -12,15 +12,18 @@
 #include <cstring>
 #include <ctime>
 #include "xu4.h"
+#include "autosave.h"
 #include "config.h"
 #include "error.h"
 #include "game.h"
 #include "gamebrowser.h"
 #include "intro.h"
 #include "progress_bar.h"
+#include "savewriter.h"
 #include "screen.h"
 #include "settings.h"
 #include "sound.h"
+#include "telemetry.h"
 #include "utils.h"
 
 #ifdef ANDROID
@@ -36,7 +39,11 @@ extern "C" const char* androidInternalData();
 #endif
 
 #ifdef DEBUG
-extern int gameSave(const char*);
+#include "combatsim.h"
+#include "context.h"
+#include "creature.h"
+#include "location.h"
+#include "snapshot.h"
 #endif
 
 
@@ -52,8 +59,6 @@ uint32_t well512_genU32(void* ws);
 #include "well512.h"
 #endif
 
-static void xu4_srandom(uint32_t);
-
 
 enum OptionsFlag {
     OPT_FULLSCREEN = 1,
@@ -63,7 +68,13 @@ enum OptionsFlag {
     OPT_FILTER     = 0x10,
     OPT_RECORD     = 0x20,
     OPT_REPLAY     = 0x40,
-    OPT_TEST_SAVE  = 0x80
+    OPT_TEST_SAVE  = 0x80,
+    OPT_TELEMETRY  = 0x100,
+    OPT_COMBAT_SIM = 0x200,
+    OPT_AUTOSAVE   = 0x400,
+    OPT_HEADLESS   = 0x800,
+    OPT_FRAME_CPU  = 0x1000,
+    OPT_TEST_SNAP  = 0x2000
 };
 
 struct Options {
@@ -74,6 +85,12 @@ struct Options {
     const char* module;
     const char* profile;
     const char* recordFile;
+    const char* telemetryFile;
+    int autosaveAge;
+    const char* frameDir;
+    const char* frameTurns;
+    const char* simCreature;
+    int simFights;
 };
 
 #define strEqual(A,B)       (strcmp(A,B) == 0)
@@ -112,11 +129,51 @@ int parseOptions(Options* opt, int argc, char** argv) {
                 goto missing_value;
             opt->profile = argv[i];
         }
+        else if (strEqual(argv[i], "--frames"))
+        {
+            if (++i >= argc)
+                goto missing_value;
+            opt->frameDir = argv[i];
+        }
+        else if (strEqual(argv[i], "--frame-turns"))
+        {
+            if (++i >= argc)
+                goto missing_value;
+            opt->frameTurns = argv[i];
+        }
+        else if (strEqual(argv[i], "--frame-cpu"))
+        {
+#ifdef GPU_RENDER
+            // The map is only drawn by the GPU, not into the screen image.
+            errorFatal("--frame-cpu is not available with GPU rendering");
+            return 0;
+#else
+            opt->flags |= OPT_FRAME_CPU;
+#endif
+        }
         else if (strEqualAlt(argv[i], "-i", "--skip-intro"))
         {
             opt->flags |= OPT_NO_INTRO;
             opt->used  |= OPT_NO_INTRO;
         }
+        else if (strEqual(argv[i], "--restore-autosave"))
+        {
+            if (++i >= argc)
+                goto missing_value;
+            opt->autosaveAge = atoi(argv[i]);
+            opt->flags |= OPT_AUTOSAVE;
+        }
+        else if (strEqualAlt(argv[i], "-t", "--telemetry"))
+        {
+            opt->flags |= OPT_TELEMETRY;
+        }
+        else if (strEqual(argv[i], "--telemetry-csv"))
+        {
+            if (++i >= argc)
+                goto missing_value;
+            opt->telemetryFile = argv[i];
+            opt->flags |= OPT_TELEMETRY;
+        }
         else if (strEqualAlt(argv[i], "-v", "--verbose"))
         {
             opt->flags |= OPT_VERBOSE;
@@ -140,6 +197,13 @@ int parseOptions(Options* opt, int argc, char** argv) {
             "Options:\n"
             "      --filter <string>   Specify display filtering mode.\n"
             "                          (point, HQX, xBR-lv2)\n"
+#ifndef GPU_RENDER
+            "      --frame-cpu         Save the unscaled screen image as frames.\n"
+#endif
+            "      --frame-turns <list>\n"
+            "                          Comma separated turns at which to save\n"
+            "                          frames; quit after the last one.\n"
+            "      --frames <dir>      Save frames to dir (every turn by default).\n"
             "  -f, --fullscreen        Run in fullscreen mode.\n"
             "  -h, --help              Print this message and quit.\n"
             "  -i, --skip-intro        Skip the intro. and load the last saved game.\n"
@@ -148,13 +212,25 @@ int parseOptions(Options* opt, int argc, char** argv) {
 #endif
             "  -p, --profile <string>  Use another set of settings and save files.\n"
             "  -q, --quiet             Disable audio.\n"
+            "      --restore-autosave <int>\n"
+            "                          Replace the saved game with an autosave\n"
+            "                          (0 is the newest).\n"
             "  -s, --scale <int>       Specify display scaling factor (1-5).\n"
+            "  -t, --telemetry         Show frame timing overlay.\n"
+            "      --telemetry-csv <file>\n"
+            "                          Show overlay and write frame times to file.\n"
             "  -v, --verbose           Enable verbose console output.\n"
 #ifdef DEBUG
             "\nDEBUG Options:\n"
             "  -c, --capture <file>    Record user input.\n"
+            "      --combat-sim <creature>\n"
+            "                          Simulate fights against creature and quit.\n"
+            "      --headless          Render offscreen without a window or audio.\n"
+            "                          Requires --replay.\n"
             "  -r, --replay <file>     Play using recorded input.\n"
+            "      --sim-fights <int>  Number of combat-sim fights (default 1000).\n"
             "      --test-save         Save to /tmp/xu4/ and quit.\n"
+            "      --test-snapshot     Check snapshot capture & restore and quit.\n"
 #endif
             "\nHomepage: http://xu4.sourceforge.net\n");
 
@@ -177,10 +253,31 @@ int parseOptions(Options* opt, int argc, char** argv) {
             opt->flags |= OPT_REPLAY;
             opt->used  |= OPT_REPLAY;
         }
+        else if (strEqual(argv[i], "--headless"))
+        {
+            opt->flags |= OPT_HEADLESS | OPT_NO_AUDIO;
+        }
+        else if (strEqual(argv[i], "--combat-sim"))
+        {
+            if (++i >= argc)
+                goto missing_value;
+            opt->simCreature = argv[i];
+            opt->flags |= OPT_COMBAT_SIM;
+        }
+        else if (strEqual(argv[i], "--sim-fights"))
+        {
+            if (++i >= argc)
+                goto missing_value;
+            opt->simFights = atoi(argv[i]);
+        }
         else if (strEqual(argv[i], "--test-save"))
         {
             opt->flags |= OPT_TEST_SAVE;
         }
+        else if (strEqual(argv[i], "--test-snapshot"))
+        {
+            opt->flags |= OPT_TEST_SNAP;
+        }
 #endif
         else {
             errorFatal("Unrecognized argument: %s\n\n"
@@ -188,6 +285,14 @@ int parseOptions(Options* opt, int argc, char** argv) {
             return 0;
         }
     }
+
+#ifdef DEBUG
+    // Without a window there is no input other than a recording.
+    if ((opt->flags & OPT_HEADLESS) && ! (opt->flags & OPT_REPLAY)) {
+        errorFatal("--headless requires --replay");
+        return 0;
+    }
+#endif
     return 1;
 
 missing_value:
@@ -234,6 +339,7 @@ static void servicesFree(XU4GameServices*);
 
 void servicesInit(XU4GameServices* gs, Options* opt) {
     gs->verbose = opt->flags & OPT_VERBOSE;
+    gs->headless = opt->flags & OPT_HEADLESS;
 
     initResourcePaths(&gs->resourcePaths);
 
@@ -265,6 +371,15 @@ void servicesInit(XU4GameServices* gs, Options* opt) {
     screenInit(LAYER_COUNT);
     Tile::initSymbols(gs->config);
 
+    if (opt->frameDir)
+        screenSetFrameCapture(opt->frameDir, opt->frameTurns,
+                              opt->flags & OPT_FRAME_CPU);
+
+    if (opt->flags & OPT_TELEMETRY) {
+        gs->telemetry = tele_create(opt->telemetryFile);
+        screenSetLayer(LAYER_TELEMETRY, tele_render, gs->telemetry);
+    }
+
     if (! (opt->flags & OPT_NO_AUDIO))
         soundInit();
 
@@ -320,7 +435,10 @@ static void servicesFreeGame(XU4GameServices* gs) {
 
 static void servicesFree(XU4GameServices* gs) {
     servicesFreeGame(gs);
+    savewriter_shutdown();
 
+    tele_free(gs->telemetry);
+    gs->telemetry = NULL;
     delete gs->settings;
     notify_free(&gs->notifyBus);
     u4fcleanup();
@@ -334,6 +452,8 @@ static void servicesReset(XU4GameServices* gs) {
     gs->config = configInit(settings->game, settings->soundtrack);
     screenInit(LAYER_COUNT);
     Tile::initSymbols(gs->config);
+    if (gs->telemetry)
+        screenSetLayer(LAYER_TELEMETRY, tele_render, gs->telemetry);
 
     soundInit();
 
@@ -350,6 +470,81 @@ static void servicesReset(XU4GameServices* gs) {
 
 XU4GameServices xu4;
 
+#ifdef DEBUG
+/*
+ * Capture the game state, alter it, then check that restoring the snapshot
+ * brings back the original state & random number sequence.
+ *
+ * Return true if the round trip is exact.
+ */
+static bool testSnapshot(Context* ctx) {
+    const int RCOUNT = 16;
+    uint32_t rstate[XU4_RANDOM_STATE_LEN];
+    int rseq[RCOUNT];
+    GameSnapshot* snap;
+    Map* map = ctx->location->map;
+    SaveGame save = *ctx->saveGame;
+    Coords pos = ctx->location->coords;
+    size_t objCount = map->objects.size();
+    TileId tile = map->data[0];
+    int i, fail = 0;
+
+    memcpy(rstate, xu4.randomSim, sizeof(rstate));
+    snap = snapshot_capture(ctx);
+    if (! snap) {
+        printf("snapshot_capture failed!\n");
+        return false;
+    }
+    if (memcmp(rstate, xu4.randomSim, sizeof(rstate))) {
+        printf("snapshot_capture changed the random state\n");
+        ++fail;
+    }
+
+    for (i = 0; i < RCOUNT; ++i)
+        rseq[i] = xu4_random(0x7fffffff);
+
+    ctx->saveGame->moves += 100;
+    ctx->location->coords.x ^= 1;
+    map->data[0] = tile + 1;
+    map->clearObjects();
+
+    if (! snapshot_restore(ctx, snap)) {
+        printf("snapshot_restore failed!\n");
+        snapshot_free(snap);
+        return false;
+    }
+    snapshot_free(snap);
+
+    if (memcmp(&save, ctx->saveGame, sizeof(save))) {
+        printf("SaveGame differs\n");
+        ++fail;
+    }
+    if (pos != ctx->location->coords) {
+        printf("Location coords differ\n");
+        ++fail;
+    }
+    if (map->data[0] != tile) {
+        printf("Map tiles differ\n");
+        ++fail;
+    }
+    if (map->objects.size() != objCount) {
+        printf("Object count differs (%d, %d)\n",
+               int(map->objects.size()), int(objCount));
+        ++fail;
+    }
+    for (i = 0; i < RCOUNT; ++i) {
+        if (xu4_random(0x7fffffff) != rseq[i]) {
+            printf("Random sequence differs\n");
+            ++fail;
+            break;
+        }
+    }
+
+    printf("snapshot round trip: %s\n", fail ? "FAILED" : "passed");
+    return fail == 0;
+}
+#endif
+
 
 int main(int argc, char *argv[]) {
 #if defined(MACOSX)
@@ -371,13 +566,19 @@ int main(int argc, char *argv[]) {
     memset(&xu4, 0, sizeof xu4);
     servicesInit(&xu4, &opt);
 
+    if (opt.flags & OPT_AUTOSAVE) {
+        if (! autosave_restore(xu4.settings->getUserPath().c_str(),
+                               opt.autosaveAge))
+            errorWarning("Cannot restore autosave %d", opt.autosaveAge);
+    }
+
 #ifdef DEBUG
     if (opt.flags & OPT_TEST_SAVE) {
         int status;
         xu4.game = new GameController();
         if (xu4.game->initContext()) {
             gameSave("/tmp/xu4/");
-            status = 0;
+            status = savewriter_wait() ? 0 : 1;
         } else {
             printf("initContext failed!\n");
             status = 1;
@@ -386,6 +587,48 @@ int main(int argc, char *argv[]) {
         servicesFree(&xu4);
         return status;
     }
+
+    if (opt.flags & OPT_TEST_SNAP) {
+        int status = 1;
+        xu4.game = new GameController();
+        if (xu4.game->initContext())
+            status = testSnapshot(c) ? 0 : 1;
+        else
+            printf("initContext failed!\n");
+        xu4.stage = StageExitGame;
+        servicesFree(&xu4);
+        return status;
+    }
+
+    if (opt.flags & OPT_COMBAT_SIM) {
+        int status = 1;
+        xu4.game = new GameController();
+        if (xu4.game->initContext()) {
+            const Creature* proto = Creature::getByName(opt.simCreature);
+            if (proto) {
+                CombatSimResult res;
+                Location* loc = c->location;
+                Creature foe(proto);
+                foe.coords = loc->coords;
+                MapId mid = xu4.game->combatMapForTile(
+                        loc->map->tileTypeAt(loc->coords, WITHOUT_OBJECTS),
+                        &foe);
+                if (combatsim_run(c->saveGame, proto, mid,
+                                  opt.simFights ? opt.simFights : 1000,
+                                  time(NULL), &res)) {
+                    combatsim_print(&res);
+                    status = 0;
+                } else
+                    printf("combatsim_run failed!\n");
+            } else
+                printf("Unknown creature: %s\n", opt.simCreature);
+        } else {
+            printf("initContext failed!\n");
+        }
+        xu4.stage = StageExitGame;
+        servicesFree(&xu4);
+        return status;
+    }
 #endif
     }
 
@@ -424,8 +667,16 @@ begin_game:
         goto begin_game;
     }
 
+    int status = 0;
+    int missed = screenCaptureMissed();
+    if (missed) {
+        fprintf(stderr, "Quit before saving %d of the --frame-turns\n",
+                missed);
+        status = 1;
+    }
+
     servicesFree(&xu4);
-    return 0;
+    return status;
 }
 
 void xu4_selectGame() {
@@ -439,14 +690,11 @@ void xu4_selectGame() {
 /*
  * Seed the random number generator.
  */
-static void xu4_srandom(uint32_t seed) {
+void xu4_srandom(uint32_t seed) {
+    well512_init(xu4.randomSim, seed);
 #ifdef USE_BORON
-    // Compiled code and module scripts share this generator.
+    // Module scripts use the Boron generator.
     boron_randomSeed(xu4.config->boronThread(), seed);
-#elif (defined(BSD) && (BSD >= 199103)) || (defined (MACOSX) || defined (IOS))
-    srandom(seed);
-#else
-    srand(seed);
 #endif
 }
 
@@ -460,24 +708,23 @@ extern "C" {
  * Generate a random number between 0 and (upperRange - 1).
  */
 int xu4_random(int upperRange) {
-#ifdef USE_BORON
+    return xu4_randomWith(xu4.randomSim, upperRange);
+}
+
+/*
+ * Generate a random number between 0 and (upperRange - 1) from a specific
+ * generator state.
+ */
+int xu4_randomWith(uint32_t* state, int upperRange) {
     if (upperRange < 2)
         return 0;
 #ifdef REPORT_RNG
-    uint32_t r = boron_random(xu4.config->boronThread());
+    uint32_t r = well512_genU32(state);
     uint32_t n = r % upperRange;
     printf( "KR rn %d %d %c\n", r, n, rpos);
     return n;
 #else
-    return boron_random(xu4.config->boronThread()) % upperRange;
-#endif
-#else
-#if (defined(BSD) && (BSD >= 199103)) || (defined (MACOSX) || defined (IOS))
-    int r = random();
-#else
-    int r = rand();
-#endif
-    return (int) ((((double)upperRange) * r) / (RAND_MAX+1.0));
+    return well512_genU32(state) % upperRange;
 #endif
 }
 
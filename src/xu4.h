@@ -8,8 +8,8 @@
 enum NotifySender {
     // Sender Id           Message
     SENDER_LOCATION,    // MoveEvent*
-    SENDER_PARTY,       // PartyEvent*
-    SENDER_AURA,        // Aura*
+    SENDER_PARTY,       // PartyEvent* or NULL when posted
+    SENDER_AURA,        // NULL (posted)
     SENDER_MENU,        // MenuEvent*
     SENDER_SETTINGS,    // Settings*
     SENDER_DISPLAY      // NULL or ScreenState*
@@ -20,10 +20,12 @@ enum DrawLayer {
     LAYER_MAP,          // When GPU_RENDER defined.
     LAYER_HUD,          // Borders and status GUI.
     LAYER_TOP_MENU,     // GameBrowser
+    LAYER_TELEMETRY,    // Frame timing overlay
 
     LAYER_COUNT
 };
 
+class Context;
 class Settings;
 class Config;
 class ImageMgr;
@@ -33,6 +35,10 @@ struct SaveGame;
 class GameBrowser;
 class IntroController;
 class GameController;
+struct Telemetry;
+
+// Number of words in a well512 random number generator state.
+#define XU4_RANDOM_STATE_LEN    17
 
 enum XU4GameStage {
     StageExitGame,
@@ -55,11 +61,14 @@ struct XU4GameServices {
     GameBrowser* gameBrowser;
     IntroController* intro;
     GameController* game;
+    Telemetry* telemetry;
     const char* errorMessage;
     uint16_t stage;
     uint16_t gameReset;         // Load another game.
-    uint32_t randomFx[17];      // Effects random number generator state.
+    uint32_t randomFx[XU4_RANDOM_STATE_LEN];  // Effects generator state.
+    uint32_t randomSim[XU4_RANDOM_STATE_LEN]; // Simulation generator state.
     bool verbose;
+    bool headless;              // Render offscreen without a window.
 };
 
 extern XU4GameServices xu4;
@@ -67,7 +76,10 @@ extern XU4GameServices xu4;
 #define gs_listen(msk,func,user)    notify_listen(&xu4.notifyBus,msk,func,user)
 #define gs_unplug(id)               notify_unplug(&xu4.notifyBus,id)
 #define gs_emitMessage(sid,data)    notify_emit(&xu4.notifyBus,sid,data);
+#define gs_postMessage(sid)         notify_post(&xu4.notifyBus,sid)
 
 void xu4_selectGame();
+void xu4_srandom(uint32_t seed);
 extern "C" int xu4_random(int upperval);
+extern "C" int xu4_randomWith(uint32_t* state, int upperval);
 extern "C" int xu4_randomFx(int upperval);